@@ -0,0 +1,87 @@
+"""
+Capacity benchmark of controller server configuration profiles.
+
+Runs load generator with increasing number of connections against server
+built with one of configuration profiles( see server/README.md ) and prints
+one markdown table row per step: connections kept open, sustained POLL
+responses per second and latency percentiles.
+
+Example:
+    python benchmark.py 192.168.1.10 9874 --label MANY_CLIENTS --steps 1,2,4,8,10,12 -d 10
+"""
+import argparse
+import selectors
+import time
+from loadgen import LoadConnection, percentile
+
+
+def run_step(args, count: int) -> tuple:
+    selector = selectors.DefaultSelector()
+    connections = [LoadConnection(idx, args) for idx in range(count)]
+    for conn in connections:
+        conn.connect(selector)
+
+    start = time.monotonic()
+    end = start + args.duration
+    while time.monotonic() < end and not all(conn.closed for conn in connections):
+        for key, mask in selector.select(timeout=0.001 if args.rate else 0.1):
+            key.data.on_event(selector, mask)
+
+        now = time.monotonic()
+        for conn in connections:
+            conn.tick(selector, now)
+
+    duration = time.monotonic() - start
+    for conn in connections:
+        conn.close(selector)
+    selector.close()
+
+    # connections refused by server are closed before they receive VERSION
+    served = [conn for conn in connections if conn.version is not None]
+    latencies = sorted(latency for conn in served for latency in conn.latencies)
+    received = sum(conn.received for conn in served)
+    errors = sum(conn.error_frames + conn.protocol_errors for conn in served)
+    return len(served), received / duration, latencies, errors
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Capacity benchmark of controller server.')
+    parser.add_argument('host')
+    parser.add_argument('port', type=int)
+    parser.add_argument('--label', default='', help='name of profile server was built with')
+    parser.add_argument('--steps', default='1,2,4,8',
+                        help='comma separated numbers of concurrent connections')
+    parser.add_argument('-d', '--duration', type=float, default=10., help='duration of each step in seconds')
+    parser.add_argument('-r', '--rate', type=float, default=0.,
+                        help='POLL requests per second per connection, 0 sends next request as soon as possible')
+    parser.add_argument('--pause', type=float, default=3.,
+                        help='seconds between steps, so server can release closed connections')
+    args = parser.parse_args()
+
+    args.steps = [int(step) for step in args.steps.split(',')]
+    # benchmark measures POLL only, values of page are not changed
+    args.depth = 1
+    args.page_wait = .1
+    args.commands = ['POLL']
+    args.weights = [1.]
+    args.set = []
+    return args
+
+
+def main():
+    args = parse_args()
+    print('| Profile | connections | served | POLL/s | p50 ms | p99 ms | errors |')
+    print('|---|---|---|---|---|---|---|')
+
+    for idx, count in enumerate(args.steps):
+        if idx:
+            time.sleep(args.pause)
+
+        served, rate, latencies, errors = run_step(args, count)
+        print(f'| {args.label} | {count} | {served} | {rate:.1f} | '
+              f'{percentile(latencies, .5) * 1000:.2f} | {percentile(latencies, .99) * 1000:.2f} | {errors} |',
+              flush=True)
+
+
+if __name__ == '__main__':
+    main()
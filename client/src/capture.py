@@ -0,0 +1,55 @@
+"""
+Capture format of protocol sessions.
+
+File starts with MAGIC, followed by records:
+    <d timestamp( seconds since start of capture )> <B direction> <I payload length> <payload>
+Payload of client record is JSON message as sent, payload of server record is frame without length prefix.
+"""
+import struct
+import time
+
+MAGIC = b'NRCCAP1\n'
+CLIENT = 0
+SERVER = 1
+
+record_header = struct.Struct('<dBI')
+
+
+class CaptureWriter:
+    def __init__(self, file_path: str):
+        self.file = open(file_path, 'wb')
+        self.file.write(MAGIC)
+        self.start = time.monotonic()
+
+    def write(self, direction: int, payload: bytes):
+        self.file.write(record_header.pack(time.monotonic() - self.start, direction, len(payload)))
+        self.file.write(payload)
+
+    def close(self):
+        self.file.close()
+
+
+def read_capture(file_path: str) -> list:
+    """
+    Returns list of (timestamp, direction, payload) records.
+    Raises ValueError if file is not capture or is truncated.
+    """
+    with open(file_path, 'rb') as file:
+        data = file.read()
+
+    if not data.startswith(MAGIC):
+        raise ValueError(f'{file_path} is not capture file.')
+
+    records = []
+    offset = len(MAGIC)
+    while offset < len(data):
+        if offset + record_header.size > len(data):
+            raise ValueError(f'{file_path} is truncated.')
+        timestamp, direction, length = record_header.unpack_from(data, offset)
+        offset += record_header.size
+        if offset + length > len(data):
+            raise ValueError(f'{file_path} is truncated.')
+        records.append((timestamp, direction, data[offset:offset + length]))
+        offset += length
+
+    return records
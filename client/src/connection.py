@@ -1,21 +1,44 @@
 import socket
+import selectors
 import json
+import time
+from os import path
+from struct import Struct
 from threading import Thread, Event
-from queue import Queue
+from queue import Queue, Empty
 from remoteInfo import RemoteInfo
-import re
-import time
+from frameReader import FrameReader, RequestTracker, split_frame
+from capture import CaptureWriter, CLIENT, SERVER
+import options
 
 
 class Connection:
+    receive_timeout = 5
+    # sequence number and page id of UDP stream datagram
+    stream_header = Struct('<IH')
+
     def __init__(self, remote: RemoteInfo):
         ip_address_string = '.'.join([str(byte) for byte in remote.ip_address])
         self.remote_address = (ip_address_string, remote.port)
 
         self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.selector = selectors.DefaultSelector()
+
+        # wakes up communication thread when message is queued for sending
+        self.wakeup_receiver, self.wakeup_sender = socket.socketpair()
 
         self.communication_thread = Thread(target=self.start_connection)
 
+        self.frame_reader = FrameReader()
+        self.send_buffer = bytearray()
+        self.pending_responses = RequestTracker()
+        self.last_receive = 0.
+        self.capture = None
+
+        # UDP socket receiving value stream, None if stream is disabled
+        self.stream_socket = None
+        self.stream_port = None
+
         # communication queues/mutexes for multithreading
         self.receive_queue = Queue()
         self.send_queue = Queue()
@@ -29,74 +52,159 @@ class Connection:
 
     def close(self):
         self.kill_event.set()
+        self._wakeup()
         self.communication_thread.join()
 
+    def send(self, msg: dict):
+        self.send_queue.put(msg)
+        self._wakeup()
+
+    def _wakeup(self):
+        try:
+            self.wakeup_sender.send(b'\0')
+        except OSError:
+            pass
+
     def start_connection(self):
         try:
             self.socket.settimeout(10)
             self.socket.connect(self.remote_address)
-            self.socket.settimeout(5)
+            self.socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            self.socket.setblocking(False)
+            if options.stream_rate:
+                self.open_stream()
             self.connected_event.set()
         except (OSError, socket.timeout):
             self.connection_failed.set()
             return
 
+        if options.capture_folder is not None:
+            file_name = f'{self.remote_address[0]}_{self.remote_address[1]}_{time.strftime("%Y%m%d_%H%M%S")}.cap'
+            self.capture = CaptureWriter(path.join(options.capture_folder, file_name))
+
         self.mainloop()
 
+    def open_stream(self):
+        self.stream_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.stream_socket.bind((self.socket.getsockname()[0], 0))
+        self.stream_socket.setblocking(False)
+        self.stream_port = self.stream_socket.getsockname()[1]
+
     def mainloop(self):
+        self.selector.register(self.socket, selectors.EVENT_READ)
+        self.selector.register(self.wakeup_receiver, selectors.EVENT_READ)
+        if self.stream_socket is not None:
+            self.selector.register(self.stream_socket, selectors.EVENT_READ)
+        self.last_receive = time.monotonic()
+
         while not (self.kill_event.is_set() or
                    self.closed_event.is_set() or
                    self.connection_failed.is_set()):
             self.communication_cycle()
 
+        self.selector.close()
         self.socket.close()
+        self.wakeup_receiver.close()
+        self.wakeup_sender.close()
+        if self.stream_socket is not None:
+            self.stream_socket.close()
+        if self.capture is not None:
+            self.capture.close()
 
     def communication_cycle(self):
-        try:
-            msg = self.receive_with_prefix()
-        except socket.timeout:
+        for key, mask in self.selector.select(timeout=self.receive_timeout):
+            if key.fileobj is self.wakeup_receiver:
+                self.wakeup_receiver.recv(4096)
+                continue
+
+            if key.fileobj is self.stream_socket:
+                self.receive_stream()
+                continue
+
+            if mask & selectors.EVENT_READ:
+                self.receive()
+
+            if mask & selectors.EVENT_WRITE:
+                self.flush()
+
+        self.queue_messages()
+
+        # server stopped responding to requests
+        if self.pending_responses and time.monotonic() - self.last_receive > self.receive_timeout:
             self.connection_failed.set()
-            return
 
-        if not msg:
-            self.closed_event.set()
-            return
+    def queue_messages(self):
+        while True:
+            try:
+                msg = self.send_queue.get_nowait()
+            except Empty:
+                break
 
-        try:
-            received = json.loads(msg.decode(errors='ignore'))
-            self.receive_queue.put(received)
-        except json.JSONDecodeError as err:
-            err_msg = err.args[0]
-            p = re.compile("Extra data: line \\d+ column \\d+ \\(char (\\d+)\\)")
-            m = p.match(err_msg)
-            if m is None:
-                self.connection_failed.set()
+            if msg is None:
+                self.kill_event.set()
                 return
 
-            parse_len = int(m.group(1))
+            if not self.pending_responses:
+                self.last_receive = time.monotonic()
+            self.pending_responses.sent(msg)
+            payload = json.dumps(msg).encode()
+            if self.capture is not None:
+                self.capture.write(CLIENT, payload)
+            self.send_buffer += payload
+
+        self.flush()
+
+    def flush(self):
+        if self.send_buffer:
             try:
-                received = json.loads(msg[:parse_len].decode())
-                self.receive_queue.put(received)
-                self.receive_queue.put(msg[parse_len:])
-            except json.JSONDecodeError:
+                sent = self.socket.send(self.send_buffer)
+                del self.send_buffer[:sent]
+            except BlockingIOError:
+                pass
+            except OSError:
                 self.connection_failed.set()
                 return
 
-        response = self.send_queue.get()
-        print('sending: ', response)
-        if response is None:
-            self.kill_event.set()
+        events = selectors.EVENT_READ
+        if self.send_buffer:
+            events |= selectors.EVENT_WRITE
+        self.selector.modify(self.socket, events)
+
+    def receive(self):
+        try:
+            data = self.socket.recv(65536)
+        except BlockingIOError:
+            return
+        except OSError:
+            self.connection_failed.set()
             return
 
-        self.socket.send(json.dumps(response).encode())
-        time.sleep(1)
+        if not data:
+            self.closed_event.set()
+            return
 
-    def receive_with_prefix(self) -> bytes:
-        prefix = self.socket.recv(4)
+        self.frame_reader.feed(data)
 
-        msg_len = int.from_bytes(prefix, byteorder='big')
+        try:
+            for frame in self.frame_reader.raw_frames():
+                if self.capture is not None:
+                    self.capture.write(SERVER, frame)
+                self.last_receive = time.monotonic()
+                msg, data = split_frame(frame)
+                self.pending_responses.received(msg)
+                self.receive_queue.put((msg, data))
+        except ValueError:
+            self.connection_failed.set()
 
-        msg = self.socket.recv(msg_len)
+    def receive_stream(self):
+        while True:
+            try:
+                datagram, address = self.stream_socket.recvfrom(65536)
+            except (BlockingIOError, OSError):
+                return
 
-        print('received:', msg)
-        return msg
+            # datagrams are not responses, so they do not affect pending_responses
+            if address[0] != self.remote_address[0] or len(datagram) < self.stream_header.size:
+                continue
+            seq, page_id = self.stream_header.unpack_from(datagram)
+            self.receive_queue.put(({"UDP": seq, "PAGE_ID": page_id}, datagram[self.stream_header.size:]))
@@ -1,5 +1,9 @@
 from tkinter import ttk
 from pageManager import PageManager
+from frameReader import RequestTracker
+import options
+import json
+import time
 
 
 class ControlPage:
@@ -18,6 +22,15 @@ class ControlPage:
         self.fallback_page = None
         self.version = None
         self.requested_page_id = None
+        self.requested_hash = None
+        # values received with PAGE message before description of page arrived
+        self.page_values = None
+        self.outstanding_requests = RequestTracker()
+        self.last_poll = 0.
+        self.page_id = None
+        self.streaming = False
+        self.last_stream = 0.
+        self.last_stream_seq = -1
 
     def set_fallback_page(self, fallback_page):
         self.fallback_page = fallback_page
@@ -25,6 +38,16 @@ class ControlPage:
     def entry_point(self, **kwargs):
         self.connection = kwargs['connection']
         self.page_manager = PageManager(self.main_frame, self.connection)
+        self.version = None
+        self.requested_page_id = None
+        self.requested_hash = None
+        self.page_values = None
+        self.outstanding_requests = RequestTracker()
+        self.last_poll = 0.
+        self.page_id = None
+        self.streaming = False
+        self.last_stream = 0.
+        self.last_stream_seq = -1
         self.set_up_page()
         self.poll_changes()
 
@@ -46,15 +69,22 @@ class ControlPage:
 
         else:
             self.process_messages()
-            self.main_frame.after(50, self.poll_changes)
-
-    def process_messages(self):
-        if self.connection.receive_queue.empty():
-            return
+            self.send_events()
+            self.main_frame.after(options.process_interval, self.poll_changes)
 
-        msg: dict = self.connection.receive_queue.get()
-        response = {"CMD": "POLL"}
+    def send(self, msg: dict):
+        self.outstanding_requests.sent(msg)
+        self.connection.send(msg)
 
+    def process_messages(self):
+        while not self.connection.receive_queue.empty():
+            msg, data = self.connection.receive_queue.get()
+            # stream datagrams answer no request
+            if 'UDP' not in msg:
+                self.outstanding_requests.received(msg)
+            self.process_message(msg, data)
+
+    def process_message(self, msg: dict, data: bytes):
         if 'ERR' in msg:
             print(msg['ERR'])
 
@@ -62,21 +92,134 @@ class ControlPage:
             self.version = msg['VERSION']
             self.init_frame.grid_remove()
             self.page_manager.grid()
-
-        if self.requested_page_id is not None:
-            self.page_manager.set_page_description(self.requested_page_id, msg)
-            self.requested_page_id = None
+            # layout is switched before stream starts, so all datagrams use new layout
+            if options.poll_layout > 1 and msg.get('LAYOUT', 1) >= options.poll_layout:
+                self.send({"CMD": "LAYOUT", "VAL": options.poll_layout})
+            if self.connection.stream_port is not None:
+                self.send({"CMD": "STREAM", "VAL": {"PORT": self.connection.stream_port, "RATE": options.stream_rate}})
+            if options.prefetch_pages:
+                self.send({"CMD": "GET", "VAL": {"PAGE": "ALL"}})
+
+        if 'LAYOUT' in msg and 'VERSION' not in msg:
+            self.page_manager.set_layout(msg['LAYOUT'])
+            # held values were encoded in previous layout
+            self.page_values = None
+
+        if 'STREAM' in msg:
+            self.streaming = msg['STREAM'] == 'OK'
+
+        if 'TEMPLATE' in msg and 'PAGE' not in msg:
+            self.process_template(msg, data)
+
+        elif 'DESC' in msg:
+            try:
+                description = json.loads(data)
+            except ValueError:
+                description = None
+
+            # prefetched description can arrive sooner than response to GET of current page
+            if description is not None and msg['DESC'] == self.requested_page_id:
+                self.show_requested_page(description, msg['HASH'])
+            elif description is not None:
+                self.page_manager.store_page_description(msg['DESC'], description, msg['HASH'])
+
+        if 'widgets' in msg and self.requested_page_id is not None:
+            self.show_requested_page(msg, self.requested_hash)
 
         if 'PAGE' in msg:
-            if not self.page_manager.change_page(msg['PAGE']):
+            self.page_values = None
+            # instance of template page is shown without GET if template is cached
+            if 'TEMPLATE' in msg:
+                self.page_manager.store_template_page(msg['PAGE'], msg['TEMPLATE'], msg['PARAMS'], msg.get('HASH'))
+            # server can attach hash of description and values of page
+            if self.page_manager.change_page(msg['PAGE'], msg.get('HASH')):
+                self.page_id = msg['PAGE']
+                self.requested_page_id = None
+            else:
+                self.page_id = None
                 self.requested_page_id = msg['PAGE']
-                response = {"CMD": "GET", "VAL": {"PAGE": self.requested_page_id}}
+                self.requested_hash = msg.get('HASH')
+                if 'VAL' in msg:
+                    self.page_values = data
+                self.send({"CMD": "GET", "VAL": {"PAGE": self.requested_page_id}})
 
         if 'VAL' in msg:
-            self.page_manager.update(self.connection.receive_queue.get())
+            # values could belong to page which was changed in meantime
+            if self.requested_page_id is None:
+                self.update_values(data)
+
+        # stream datagrams can be reordered or belong to previous page
+        if 'UDP' in msg and msg['PAGE_ID'] == self.page_id and msg['UDP'] > self.last_stream_seq:
+            self.last_stream_seq = msg['UDP']
+            self.last_stream = time.monotonic()
+            self.update_values(data)
+
+        if 'SERIES' in msg and self.requested_page_id is None:
+            try:
+                self.page_manager.add_samples(data)
+            except ValueError:
+                pass
+
+    def process_template(self, msg: dict, data: bytes):
+        """
+        Stores template page from response to GET or GET ALL.
+        Template follows header only with its first instance, other instances reference it by hash.
+        """
+        if data:
+            self.page_manager.store_template(msg['TEMPLATE'], str(data, errors='replace'))
+
+        page_id = msg['DESC'] if 'DESC' in msg else self.requested_page_id
+        if page_id is None:
+            return
 
-        if not self.page_manager.event_queue.empty() and response["CMD"] == 'POLL':
-            event = self.page_manager.event_queue.get()
-            response = {"CMD": "SET", "VAL": event}
+        description_hash = msg['HASH'] if 'HASH' in msg else self.requested_hash
+        self.page_manager.store_template_page(page_id, msg['TEMPLATE'], msg['PARAMS'], description_hash)
+        if page_id == self.requested_page_id:
+            self.show_requested_page(None, description_hash)
+
+    def show_requested_page(self, description: dict = None, description_hash: str = None):
+        # template pages are already stored as reference to template
+        if description is not None:
+            self.page_manager.store_page_description(self.requested_page_id, description, description_hash)
+        self.page_manager.change_page(self.requested_page_id)
+        self.page_id = self.requested_page_id
+        self.requested_page_id = None
+        if self.page_values is not None:
+            self.update_values(self.page_values)
+            self.page_values = None
+
+    def update_values(self, data: bytes):
+        try:
+            self.page_manager.update(data)
+        except ValueError:
+            pass
+
+    def send_events(self):
+        if self.version is None:
+            return
 
-        self.connection.send_queue.put(response)
+        # events are sent immediately, without waiting for previous responses
+        events = []
+        while not self.page_manager.event_queue.empty():
+            event = self.page_manager.event_queue.get()
+            # widget shows local state now, server value has to be applied again
+            self.page_manager.invalidate(event[0])
+            events.append(event)
+
+        # several events are applied by server at once with single response
+        if len(events) == 1:
+            self.send({"CMD": "SET", "VAL": events[0]})
+        elif events:
+            self.send({"CMD": "SET", "VAL": events})
+
+        now = time.monotonic()
+        # charts fetch new samples after POLL announced them
+        if not self.outstanding_requests:
+            for request in self.page_manager.series_requests():
+                self.send({"CMD": "SERIES", "VAL": request})
+
+        # stream replaces POLL until datagrams stop arriving
+        stream_alive = self.streaming and now - self.last_stream < options.stream_timeout
+        if not self.outstanding_requests and now - self.last_poll >= options.poll_interval and not stream_alive:
+            self.last_poll = now
+            self.send({"CMD": "POLL"})
@@ -1,10 +1,14 @@
 from tkinter import *
 from tkinter import ttk
 from queue import Queue
-from struct import unpack
+from collections import deque
+from struct import Struct
 
 
 class BaseElement:
+    # type of value sent by server, None for widgets without value
+    value_type = None
+
     def __init__(self, root, element_id: int, event_queue: Queue):
         self.root = root
         self.main_frame = ttk.Frame(root)
@@ -20,8 +24,11 @@ class BaseElement:
 
 
 class ButtonElement(BaseElement):
+    value_type = 'int32'
+
     def __init__(self, root, element_id: int, event_queue: Queue, description: dict):
         super().__init__(root, element_id, event_queue)
+        self.value_type = description['value_type'] if 'value_type' in description else 'int32'
         self.text: str = description['text']
         self.text_disabled = description['text_disabled'] if 'text_disabled' in description else ""
         self.button = ttk.Button(self.main_frame, text=self.text)
@@ -30,15 +37,14 @@ class ButtonElement(BaseElement):
         self.button.grid(column=0, row=0)
         self.pressed = False
 
-    def update(self, value: bytes):
-        self.pressed = bool(int.from_bytes(value[:4], byteorder='little'))
-        self.enabled = bool(value[4])
+    def set_value(self, value: int, enabled: bool):
+        self.pressed = bool(value)
+        self.enabled = enabled
 
         self.button.state([
             'pressed' if self.pressed else '!pressed',
             '!disabled' if self.enabled else 'disabled'
         ])
-        return value[5:]
 
     def press_callback(self, _):
         self.change_callback_queue.put([self.element_id, 1])
@@ -57,9 +63,12 @@ class LabelElement(BaseElement):
 
 
 class EntryElement(BaseElement):
+    value_type = 'string'
+
     def __init__(self, root, element_id: int, event_queue: Queue, description: dict):
         super().__init__(root, element_id, event_queue)
         self.text: str = ''
+        self.value: str = ''
         if 'text' in description:
             self.text = description['text']
         self.label = ttk.Label(self.main_frame, text=self.text)
@@ -82,13 +91,14 @@ class EntryElement(BaseElement):
         self.has_focus = False
         if self.enabled:
             self.change_callback_queue.put([self.element_id, self.tk_value.get()])
+        else:
+            self.tk_value.set(self.value)
 
-    def update(self, value: bytes):
-        string_len = value.find(0)
+    def set_value(self, value: str, enabled: bool):
+        self.value = value
         if not self.has_focus:
-            self.tk_value.set(value[:string_len].decode())
-        self.enabled = bool(value[string_len+1])
-        return value[string_len+2:]
+            self.tk_value.set(value)
+        self.enabled = enabled
 
 
 class ValueElement(BaseElement):
@@ -97,7 +107,10 @@ class ValueElement(BaseElement):
         self.text = description['text']
         self.unit = description['unit'] if 'unit' in description else ''
         self.value_type = description['value_type'] if 'value_type' in description else 'string'
-        self.value = {'int32': 0, 'float': 0., 'string': ''}[self.value_type]
+        # fixed point values are received multiplied by 10^scale
+        self.scale = description['scale'] if 'scale' in description else 0
+        self.value = {'int32': 0, 'float': 0., 'string': '', 'bool': False, 'u8': 0, 'i16': 0,
+                      'u32': 0, 'fixed': 0., 'double': 0.}[self.value_type]
         self.tk_value = StringVar(value=str(self.value))
         self.special = description['special'] if 'special' in description else dict()
         self.text_label = ttk.Label(self.main_frame, text=self.text)
@@ -110,20 +123,12 @@ class ValueElement(BaseElement):
         self.value_label.grid(column=0, row=0)
         self.unit_label.grid(column=1, row=0)
 
-    def update(self, value: bytes):
-        match self.value_type:
-            case 'int32':
-                self.value = int.from_bytes(value[:4], byteorder='little')
-                value = value[5:]
-            case 'float':
-                [self.value] = unpack('f', value[:4])
-                value = value[5:]
-            case 'string':
-                string_len = value.find(0)
-                self.value = value[:string_len]
-                value = value[string_len + 2:]
+    def set_value(self, value, enabled: bool):
+        if self.value_type == 'fixed':
+            value /= 10 ** self.scale
+        self.value = value
+        self.enabled = enabled
         self._update()
-        return value
 
     def _update(self):
         if self.value_type == 'string':
@@ -154,15 +159,20 @@ class ValueElement(BaseElement):
 
     def restore_special(self):
         self.unit_label.grid()
-        if self.value_type == 'float':
+        if self.value_type in ('float', 'double'):
             self.tk_value.set('{:.2f}'.format(self.value))
+        elif self.value_type == 'fixed':
+            self.tk_value.set('{:.{}f}'.format(self.value, self.scale))
         else:
             self.tk_value.set(str(self.value))
 
 
 class SwitchElement(BaseElement):
+    value_type = 'int32'
+
     def __init__(self, root, element_id: int, event_queue: Queue, description: dict):
         super().__init__(root, element_id, event_queue)
+        self.value_type = description['value_type'] if 'value_type' in description else 'int32'
         self.value = IntVar(value=0)
         self.texts = description['text'].split(',')
         self.show_zero = description['show_zero'] if 'show_zero' in description else True
@@ -181,11 +191,145 @@ class SwitchElement(BaseElement):
     def change_callback(self):
         self.change_callback_queue.put([self.element_id, self.value.get()])
 
-    def update(self, value: bytes):
-        self.value.set(int.from_bytes(value[:4], byteorder='little'))
-        self.enabled = bool(value[4])
+    def set_value(self, value: int, enabled: bool):
+        self.value.set(value)
+        self.enabled = enabled
+
+
+class ChartElement(BaseElement):
+    """
+    Chart of time-series widget.
+    POLL value is sequence number of next sample on server, samples are fetched by SERIES command.
+    """
+    value_type = 'series'
+    batch_header = Struct('<HIH')
+    sample = Struct('<If')
+
+    def __init__(self, root, element_id: int, event_queue: Queue, description: dict):
+        super().__init__(root, element_id, event_queue)
+        self.text = description['text'] if 'text' in description else ''
+        self.unit = description['unit'] if 'unit' in description else ''
+        self.range = description['range'] if 'range' in description else None
+        self.width = description['width'] if 'width' in description else 300
+        self.height = description['height'] if 'height' in description else 120
+        self.samples = deque(maxlen=description['samples'] if 'samples' in description else 1000)
+
+        # sequence number of next sample which is not received yet, None until first batch
+        self.next_seq = None
+        self.available_seq = 0
+        self.requested = False
+
+        self.text_label = ttk.Label(self.main_frame, text=f'{self.text} [{self.unit}]' if self.unit else self.text)
+        self.canvas = Canvas(self.main_frame, width=self.width, height=self.height, background='white')
+        self.line = self.canvas.create_line(0, 0, 0, 0, fill='blue')
+        self.text_label.grid(column=0, row=0)
+        self.canvas.grid(column=0, row=1)
+
+    def set_value(self, value: int, enabled: bool):
+        self.available_seq = value
+        self.enabled = enabled
+
+    def series_request(self):
+        """
+        Returns [widget_id, sequence number] for SERIES command or None if no new samples are available.
+        """
+        if self.requested or self.next_seq == self.available_seq:
+            return None
+        self.requested = True
+        return [self.element_id, self.next_seq if self.next_seq is not None else 0]
+
+    def add_samples(self, first_seq: int, data: memoryview):
+        self.requested = False
+        if self.next_seq is not None and first_seq != self.next_seq:
+            # samples were overwritten on server before client fetched them
+            self.samples.clear()
+
+        self.samples.extend(self.sample.iter_unpack(data))
+        self.next_seq = first_seq + len(data) // self.sample.size
+        self._redraw()
+
+    def _redraw(self):
+        if len(self.samples) < 2:
+            return
+
+        values = [value for _, value in self.samples]
+        low, high = self.range if self.range else (min(values), max(values))
+        if high == low:
+            high = low + 1
+
+        start = self.samples[0][0]
+        duration = max(self.samples[-1][0] - start, 1)
+        coords = []
+        for timestamp, value in self.samples:
+            coords.append((timestamp - start) * self.width / duration)
+            coords.append(self.height - (value - low) * self.height / (high - low))
+        self.canvas.coords(self.line, coords)
+
+
+class ArrayElement(BaseElement):
+    """
+    Array widget, elements of single numeric type shown as grid of entries.
+    Edited element is sent as [index, value] pair.
+    """
+
+    def __init__(self, root, element_id: int, event_queue: Queue, description: dict):
+        super().__init__(root, element_id, event_queue)
+        self.element_type = description['value_type'] if 'value_type' in description else 'int32'
+        self.value_type = self.element_type + '[]'
+        self.scale = description['scale'] if 'scale' in description else 0
+        self.text = description['text'] if 'text' in description else ''
+        self.columns = description['columns'] if 'columns' in description else 8
+        width = description['width'] if 'width' in description else 6
+        self.values = [0] * description['length']
+        self.focused = None
+
+        self.text_label = ttk.Label(self.main_frame, text=self.text)
+        self.grid_frame = ttk.Frame(self.main_frame)
+        self.text_label.grid(column=0, row=0)
+        self.grid_frame.grid(column=0, row=1)
+
+        self.tk_values = []
+        for idx in range(len(self.values)):
+            tk_value = StringVar(value=self._format(0))
+            entry = ttk.Entry(self.grid_frame, textvariable=tk_value, width=width)
+            entry.bind('<FocusIn>', lambda _, index=idx: self.focus_in_callback(index))
+            entry.bind('<FocusOut>', lambda _, index=idx: self.focus_out_callback(index))
+            entry.bind('<Return>', self.return_press_callback)
+            entry.grid(column=idx % self.columns, row=idx // self.columns)
+            self.tk_values.append(tk_value)
+
+    def _format(self, value) -> str:
+        if self.element_type == 'fixed':
+            return '{:.{}f}'.format(value / 10 ** self.scale, self.scale)
+        if self.element_type in ('float', 'double'):
+            return '{:.2f}'.format(value)
+        return str(int(value))
+
+    def return_press_callback(self, _):
+        self.main_frame.focus_set()
+
+    def focus_in_callback(self, index: int):
+        self.focused = index
+
+    def focus_out_callback(self, index: int):
+        self.focused = None
+        text = self.tk_values[index].get()
+        try:
+            value = float(text) if self.element_type in ('float', 'double', 'fixed') else int(text)
+        except ValueError:
+            value = None
+
+        if self.enabled and value is not None:
+            self.change_callback_queue.put([self.element_id, [index, value]])
+        else:
+            self.tk_values[index].set(self._format(self.values[index]))
 
-        return value[5:]
+    def set_value(self, values: list, enabled: bool):
+        self.values = values
+        self.enabled = enabled
+        for idx, (tk_value, value) in enumerate(zip(self.tk_values, values)):
+            if idx != self.focused:
+                tk_value.set(self._format(value))
 
 
 widget_type_str = {
@@ -193,5 +337,7 @@ widget_type_str = {
     "label": LabelElement,
     "entry": EntryElement,
     "value": ValueElement,
-    "switch": SwitchElement
+    "switch": SwitchElement,
+    "chart": ChartElement,
+    "array": ArrayElement
 }
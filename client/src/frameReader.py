@@ -0,0 +1,134 @@
+import json
+from collections import deque
+
+
+class FrameReader:
+    """
+    Extracts length-prefixed frames from stream of received data.
+    Each frame consists of JSON header optionally followed by binary data( for example {"VAL":"BIN"} ).
+    """
+    prefix_len = 4
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.position = 0
+
+    def feed(self, data: bytes):
+        # drop already extracted frames before appending, so buffer does not grow indefinitely
+        if self.position:
+            del self.buffer[:self.position]
+            self.position = 0
+        self.buffer += data
+
+    def frames(self):
+        """
+        Yields complete frames as (header, binary data) pairs.
+        Raises ValueError when frame does not start with valid JSON object.
+        """
+        for frame in self.raw_frames():
+            yield split_frame(frame)
+
+    def raw_frames(self):
+        """
+        Yields payloads of complete frames, each view is released when next frame is requested.
+        """
+        view = memoryview(self.buffer)
+        try:
+            while len(view) - self.position >= self.prefix_len:
+                start = self.position + self.prefix_len
+                msg_len = int.from_bytes(view[self.position:start], byteorder='big')
+                if len(view) < start + msg_len:
+                    break
+
+                self.position = start + msg_len
+                frame = view[start:start + msg_len]
+                try:
+                    yield frame
+                finally:
+                    frame.release()
+        finally:
+            view.release()
+
+
+def split_frame(frame: memoryview) -> tuple:
+    header_len = json_length(frame)
+    if not header_len:
+        raise ValueError('Frame does not start with JSON object.')
+
+    header = json.loads(bytes(frame[:header_len]))
+    return header, bytes(frame[header_len:])
+
+
+# frames answering each command, server also sends greeting and pushes PAGE on its own
+RESPONSES = {
+    'GET': ('DESC', 'TEMPLATE', 'widgets', 'ERR'),
+    'SET': ('VAL', 'PAGE', 'ERR'),
+    'POLL': ('VAL', 'ERR'),
+    'LAYOUT': ('LAYOUT', 'ERR'),
+    'STREAM': ('STREAM', 'ERR'),
+    'SERIES': ('SERIES', 'ERR'),
+}
+
+
+class RequestTracker:
+    """
+    Matches received frames to sent requests, server answers requests in order of arrival.
+    Response to GET ALL consists of one frame per page, only last one completes request.
+    PAGE answers only SET, PAGE pushed just before response to SET can not be told apart from it
+    and completes SET one frame early.
+    """
+    def __init__(self):
+        self.commands = deque()
+
+    def __len__(self):
+        return len(self.commands)
+
+    def sent(self, msg: dict):
+        self.commands.append(msg.get('CMD'))
+
+    def received(self, header: dict) -> bool:
+        """
+        Returns True if frame completes oldest outstanding request.
+        """
+        if not self.commands or 'VERSION' in header:
+            return False
+
+        command = self.commands[0]
+        if 'PAGE' in header and command != 'SET':
+            return False
+        if not any(key in header for key in RESPONSES.get(command, ('ERR',))):
+            return False
+        if 'DESC' in header and header['DESC'] + 1 < header['COUNT']:
+            return False
+
+        self.commands.popleft()
+        return True
+
+
+def json_length(data: memoryview) -> int:
+    """
+    Finds length of JSON object or array at beginning of data.
+    Returns 0 if data does not start with complete JSON object/array.
+    """
+    depth = 0
+    in_string = False
+    escaped = False
+    for idx, char in enumerate(data):
+        if in_string:
+            if escaped:
+                escaped = False
+            elif char == 0x5c:  # backslash
+                escaped = True
+            elif char == 0x22:  # quotes
+                in_string = False
+        elif char == 0x22:
+            in_string = True
+        elif char == 0x7b or char == 0x5b:  # { [
+            depth += 1
+        elif char == 0x7d or char == 0x5d:  # } ]
+            depth -= 1
+            if depth == 0:
+                return idx + 1
+        elif depth == 0 and char not in b' \t\r\n':
+            return 0
+    return 0
@@ -0,0 +1,302 @@
+"""
+Headless load generator for controller server.
+
+Opens N concurrent connections, follows VERSION/PAGE/GET/POLL/SET dialog
+and reports throughput, latency percentiles and error frames per connection.
+
+Example:
+    python loadgen.py 192.168.1.10 9874 -n 4 -d 30 --rate 20 --mix poll=8,set=1,get=1 --set 0:1 --set 0:0
+"""
+import argparse
+import json
+import random
+import selectors
+import socket
+import time
+from collections import deque
+from frameReader import FrameReader
+
+
+# kinds of frames which answer each command
+RESPONSES = {
+    'GET': ('DESC', 'ERR'),
+    'SET': ('VAL', 'PAGE', 'ERR'),
+    'POLL': ('VAL', 'ERR'),
+}
+
+
+def frame_kind(msg: dict) -> str:
+    if 'PAGE' in msg:
+        return 'PAGE'
+    if 'VAL' in msg:
+        return 'VAL'
+    if 'ERR' in msg:
+        return 'ERR'
+    return 'DESC'
+
+
+class LoadConnection:
+    def __init__(self, index: int, args):
+        self.index = index
+        self.args = args
+        self.socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        self.socket.setblocking(False)
+        self.frame_reader = FrameReader()
+        self.send_buffer = bytearray()
+
+        self.connected = False
+        self.closed = False
+        self.version = None
+        self.page_id = None
+        self.known_pages = set()
+
+        # (command, send time) of requests waiting for response
+        self.outstanding = deque()
+        self.next_send = 0.
+        # arrival time of PAGE which is either response to SET or pushed by server
+        self.held_page = None
+
+        self.sent = 0
+        self.received = 0
+        self.pushed_pages = 0
+        self.error_frames = 0
+        self.protocol_errors = 0
+        self.latencies = []
+
+    def connect(self, selector):
+        self.socket.connect_ex((self.args.host, self.args.port))
+        selector.register(self.socket, selectors.EVENT_READ | selectors.EVENT_WRITE, self)
+
+    def close(self, selector):
+        if self.closed:
+            return
+        self.closed = True
+        selector.unregister(self.socket)
+        self.socket.close()
+
+    def on_event(self, selector, mask: int):
+        if not self.connected and mask & selectors.EVENT_WRITE:
+            if self.socket.getsockopt(socket.SOL_SOCKET, socket.SO_ERROR):
+                self.protocol_errors += 1
+                self.close(selector)
+                return
+            self.connected = True
+            self.socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+        if mask & selectors.EVENT_READ:
+            self.receive(selector)
+
+        if not self.closed and mask & selectors.EVENT_WRITE:
+            self.flush(selector)
+
+    def receive(self, selector):
+        try:
+            data = self.socket.recv(65536)
+        except BlockingIOError:
+            return
+        except OSError:
+            data = b''
+
+        if not data:
+            self.close(selector)
+            return
+
+        self.frame_reader.feed(data)
+        try:
+            for msg, _ in self.frame_reader.frames():
+                self.process_frame(msg)
+        except ValueError:
+            self.protocol_errors += 1
+            self.close(selector)
+
+    def process_frame(self, msg: dict):
+        now = time.monotonic()
+
+        if 'VERSION' in msg:
+            self.version = msg['VERSION']
+            self.next_send = now
+            self.change_page(msg['PAGE'])
+            return
+
+        kind = frame_kind(msg)
+
+        # pushed PAGE is followed by response to SET, while PAGE answering SET is followed
+        # only by description of new page( or nothing )
+        if self.held_page is not None:
+            held_time, self.held_page = self.held_page, None
+            if kind == 'DESC':
+                self.answer(held_time)
+            else:
+                self.pushed_pages += 1
+
+        if not self.outstanding or kind not in RESPONSES[self.outstanding[0][0]]:
+            if kind == 'PAGE':
+                self.pushed_pages += 1
+                self.change_page(msg['PAGE'])
+            else:
+                self.protocol_errors += 1
+            return
+
+        if kind == 'PAGE':
+            self.held_page = now
+            self.change_page(msg['PAGE'])
+            return
+
+        self.answer(now)
+        if kind == 'ERR':
+            self.error_frames += 1
+
+    def answer(self, receive_time: float):
+        command, send_time = self.outstanding.popleft()
+        self.received += 1
+        self.latencies.append(receive_time - send_time)
+
+    def change_page(self, page_id: int):
+        self.page_id = page_id
+        if page_id not in self.known_pages:
+            self.known_pages.add(page_id)
+            self.request('GET')
+
+    def request(self, command: str):
+        if command == 'GET':
+            msg = {"CMD": "GET", "VAL": {"PAGE": self.page_id}}
+        elif command == 'SET':
+            msg = {"CMD": "SET", "VAL": random.choice(self.args.set)}
+        else:
+            msg = {"CMD": "POLL"}
+
+        self.outstanding.append((command, time.monotonic()))
+        self.send_buffer += json.dumps(msg).encode()
+        self.sent += 1
+
+    def tick(self, selector, now: float):
+        if self.closed or self.version is None:
+            return
+
+        # no other frame arrived, so held PAGE was response to SET
+        if self.held_page is not None and now - self.held_page >= self.args.page_wait:
+            held_time, self.held_page = self.held_page, None
+            self.answer(held_time)
+
+        # requests are not pipelined after SET, so its PAGE response can be told from pushed one
+        if len(self.outstanding) < self.args.depth and now >= self.next_send and \
+                not any(command == 'SET' for command, _ in self.outstanding):
+            self.request(random.choices(self.args.commands, self.args.weights)[0])
+            if self.args.rate:
+                self.next_send = max(self.next_send + 1 / self.args.rate, now - 1 / self.args.rate)
+
+        self.flush(selector)
+
+    def flush(self, selector):
+        if self.send_buffer:
+            try:
+                sent = self.socket.send(self.send_buffer)
+                del self.send_buffer[:sent]
+            except BlockingIOError:
+                pass
+            except OSError:
+                self.close(selector)
+                return
+
+        events = selectors.EVENT_READ
+        if self.send_buffer or not self.connected:
+            events |= selectors.EVENT_WRITE
+        selector.modify(self.socket, events, self)
+
+
+def percentile(sorted_values: list, fraction: float) -> float:
+    if not sorted_values:
+        return float('nan')
+    return sorted_values[min(int(fraction * len(sorted_values)), len(sorted_values) - 1)]
+
+
+def report(connections: list, duration: float):
+    print(f'{"conn":>5} {"sent":>8} {"recv":>8} {"req/s":>8} {"p50 ms":>8} {"p90 ms":>8} {"p99 ms":>8} '
+          f'{"max ms":>8} {"ERR":>5} {"proto":>5} {"push":>5} {"state":>7}')
+
+    def row(name, sent, received, latencies, errors, protocol_errors, pushed, state):
+        latencies = sorted(latencies)
+        print(f'{name:>5} {sent:>8} {received:>8} {received / duration:>8.1f} '
+              f'{percentile(latencies, .5) * 1000:>8.2f} {percentile(latencies, .9) * 1000:>8.2f} '
+              f'{percentile(latencies, .99) * 1000:>8.2f} {(latencies[-1] if latencies else float("nan")) * 1000:>8.2f} '
+              f'{errors:>5} {protocol_errors:>5} {pushed:>5} {state:>7}')
+
+    for conn in connections:
+        row(conn.index, conn.sent, conn.received, conn.latencies, conn.error_frames,
+            conn.protocol_errors, conn.pushed_pages, 'closed' if conn.closed else 'open')
+
+    row('all', sum(conn.sent for conn in connections), sum(conn.received for conn in connections),
+        [latency for conn in connections for latency in conn.latencies],
+        sum(conn.error_frames for conn in connections), sum(conn.protocol_errors for conn in connections),
+        sum(conn.pushed_pages for conn in connections),
+        f'{sum(not conn.closed for conn in connections)}/{len(connections)}')
+
+
+def parse_mix(mix: str) -> dict:
+    weights = {'poll': 1., 'set': 0., 'get': 0.}
+    for item in mix.split(','):
+        command, weight = item.split('=')
+        if command not in weights:
+            raise argparse.ArgumentTypeError(f'unknown command {command}')
+        weights[command] = float(weight)
+    return weights
+
+
+def parse_set(event: str) -> list:
+    widget_id, value = event.split(':', 1)
+    try:
+        value = json.loads(value)
+    except json.JSONDecodeError:
+        pass
+    return [int(widget_id), value]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Load generator for controller server.')
+    parser.add_argument('host')
+    parser.add_argument('port', type=int)
+    parser.add_argument('-n', '--connections', type=int, default=1, help='number of concurrent connections')
+    parser.add_argument('-d', '--duration', type=float, default=10., help='test duration in seconds')
+    parser.add_argument('-r', '--rate', type=float, default=0.,
+                        help='requests per second per connection, 0 sends next request as soon as possible')
+    parser.add_argument('--depth', type=int, default=1, help='maximal number of pipelined requests per connection')
+    parser.add_argument('--mix', type=parse_mix, default='poll=1',
+                        help='relative weights of commands, e.g. poll=8,set=1,get=1')
+    parser.add_argument('--set', type=parse_set, action='append', default=[],
+                        help='SET event WIDGET_ID:JSON_VALUE, may be repeated')
+    parser.add_argument('--page-wait', type=float, default=.1,
+                        help='seconds to wait after PAGE before it is taken as response to SET')
+    args = parser.parse_args()
+
+    if args.mix['set'] and not args.set:
+        parser.error('SET in mix requires at least one --set event')
+
+    args.commands = [command.upper() for command in args.mix]
+    args.weights = list(args.mix.values())
+    return args
+
+
+def main():
+    args = parse_args()
+    selector = selectors.DefaultSelector()
+    connections = [LoadConnection(idx, args) for idx in range(args.connections)]
+    for conn in connections:
+        conn.connect(selector)
+
+    start = time.monotonic()
+    end = start + args.duration
+    while time.monotonic() < end and not all(conn.closed for conn in connections):
+        for key, mask in selector.select(timeout=0.001 if args.rate else 0.1):
+            key.data.on_event(selector, mask)
+
+        now = time.monotonic()
+        for conn in connections:
+            conn.tick(selector, now)
+
+    report(connections, time.monotonic() - start)
+    for conn in connections:
+        conn.close(selector)
+
+
+if __name__ == '__main__':
+    main()
@@ -2,3 +2,24 @@ from os import path
 
 
 assets_path = '../assets'
+
+# descriptions of all pages are fetched in background after connecting
+prefetch_pages = True
+
+# binary layout of values requested from server, 2 is compact layout supported by newer servers
+poll_layout = 2
+
+# time between POLL commands in seconds
+poll_interval = 0.1
+
+# rate of UDP value stream requested from server in datagrams per second, 0 disables stream
+stream_rate = 0
+
+# POLL is used again when no stream datagram arrived for this long in seconds
+stream_timeout = 1.
+
+# period of processing received messages and GUI events in ms
+process_interval = 10
+
+# folder where protocol sessions are recorded for replay.py, None disables recording
+capture_folder = None
@@ -3,7 +3,9 @@ import os
 from os import path
 import options
 from connection import Connection
+from valueDecoder import ValueDecoder
 import pickle
+import json
 from queue import Queue
 from copy import deepcopy
 
@@ -13,6 +15,15 @@ class PageManager:
         self.main_frame = ttk.Frame(root)
         self.current_page = None
         self.widgets = []
+        self.valued_widgets = []
+        self.charts = []
+        self.value_decoder = ValueDecoder([])
+        # binary layout of values negotiated with server
+        self.layout = 1
+        # last value shown by each valued widget, changes waiting for idle-time refresh
+        self.last_values = []
+        self.pending_values = dict()
+        self.refresh_scheduled = False
         self.position_assigner = None
         self.current_id = None
         self.page_description_folder = path.join(options.assets_path, 'saved_pages')
@@ -27,11 +38,17 @@ class PageManager:
     def grid_remove(self):
         self.main_frame.grid_remove()
 
-    def change_page(self, page_id: int) -> bool:
+    def change_page(self, page_id: int, description_hash: str = None) -> bool:
+        """
+        Shows page from cached description.
+        Returns False if description is not cached or its hash differs from hash announced by server.
+        """
         self.event_queue.queue.clear()
         page_description = self._load_page_description(page_id)
         if not page_description:
             return False
+        if description_hash is not None and page_description.get('hash') != description_hash:
+            return False
 
         for widget in self.widgets:
             widget.grid_remove()
@@ -42,6 +59,11 @@ class PageManager:
         self.current_id = 0
 
         self.parse_widgets(page_description['widgets'])
+        self.valued_widgets = [widget for widget in self.widgets if widget.value_type is not None]
+        self.charts = [widget for widget in self.valued_widgets if type(widget) is ChartElement]
+        self.value_decoder = ValueDecoder([widget.value_type for widget in self.valued_widgets], self.layout)
+        self.last_values = [None] * len(self.valued_widgets)
+        self.pending_values.clear()
         return True
 
     def parse_widgets(self, widgets: list):
@@ -62,35 +84,133 @@ class PageManager:
         new_widget.grid(**self.position_assigner.get_position())
 
     def update(self, values: bytes):
-        for widget in self.widgets:
-            if type(widget) is LabelElement:
-                continue
-            values = widget.update(values)
-
-    def set_page_description(self, page_id: int, page_description: dict):
-        if not path.isdir(self.page_description_folder):
-            os.mkdir(self.page_description_folder)
-
-        if not path.isdir(self.connection_description_folder):
-            os.mkdir(self.connection_description_folder)
+        for idx, value in enumerate(self.value_decoder.decode(values)):
+            if value != self.last_values[idx]:
+                self.last_values[idx] = value
+                self.pending_values[idx] = value
+
+        if self.pending_values and not self.refresh_scheduled:
+            self.refresh_scheduled = True
+            self.main_frame.after_idle(self._refresh)
+
+    def set_layout(self, layout: int):
+        self.layout = layout
+        self.value_decoder = ValueDecoder(self.value_decoder.value_types, layout)
+
+    def series_requests(self) -> list:
+        """
+        Returns [widget_id, sequence number] pairs of charts which have new samples available on server.
+        """
+        requests = []
+        for chart in self.charts:
+            request = chart.series_request()
+            if request is not None:
+                requests.append(request)
+        return requests
+
+    def add_samples(self, data: bytes):
+        """
+        Passes batch of samples received as response to SERIES command to its chart.
+        Raises ValueError if batch is malformed.
+        """
+        if len(data) < ChartElement.batch_header.size:
+            raise ValueError('Series batch too short.')
+
+        widget_id, first_seq, count = ChartElement.batch_header.unpack_from(data)
+        samples = memoryview(data)[ChartElement.batch_header.size:]
+        if len(samples) != count * ChartElement.sample.size:
+            raise ValueError('Series batch length does not match sample count.')
+
+        if 0 <= widget_id < len(self.valued_widgets) and type(self.valued_widgets[widget_id]) is ChartElement:
+            self.valued_widgets[widget_id].add_samples(first_seq, samples)
+
+    def invalidate(self, element_id: int):
+        """
+        Forces refresh of widget on next update, used when user changed widget locally.
+        """
+        if 0 <= element_id < len(self.last_values):
+            self.last_values[element_id] = None
+
+    def _refresh(self):
+        self.refresh_scheduled = False
+        for idx, (value, enabled) in self.pending_values.items():
+            self.valued_widgets[idx].set_value(value, enabled)
+        self.pending_values.clear()
+
+    def store_page_description(self, page_id: int, page_description: dict, description_hash: str = None):
+        self._make_folders()
+
+        # hash is stored with description, so changed firmware invalidates cache
+        if description_hash is not None:
+            page_description['hash'] = description_hash
 
         file_path = self._file_path(page_id)
         with open(file_path, 'wb') as file:
             pickle.dump(page_description, file)
 
-        self.change_page(page_id)
+    def store_template(self, template_hash: str, template: str):
+        """
+        Stores template shared by several pages, pages reference it by hash.
+        """
+        self._make_folders()
+        with open(self._template_path(template_hash), 'w', encoding='utf-8') as file:
+            file.write(template)
+
+    def store_template_page(self, page_id: int, template_hash: str, params: dict, description_hash: str = None):
+        """
+        Stores page instantiated from template as reference to template and its parameters.
+        """
+        self.store_page_description(page_id, {'template': template_hash, 'params': params}, description_hash)
 
     def _load_page_description(self, page_id: int) -> dict:
         file_path = self._file_path(page_id)
         try:
             with open(file_path, 'rb') as file:
-                return pickle.load(file)
+                page_description = pickle.load(file)
+        except FileNotFoundError:
+            return dict()
+
+        if 'template' not in page_description:
+            return page_description
+
+        try:
+            with open(self._template_path(page_description['template']), encoding='utf-8') as file:
+                template = file.read()
         except FileNotFoundError:
             return dict()
 
+        try:
+            description = instantiate_template(template, page_description['params'])
+        except ValueError:
+            return dict()
+        description['hash'] = page_description.get('hash')
+        return description
+
+    def _template_path(self, template_hash: str) -> str:
+        return path.join(self.connection_description_folder, 'template_' + template_hash + '.json')
+
     def _file_path(self, page_id) -> str:
         return path.join(self.connection_description_folder, str(page_id) + '.dat')
 
+    def _make_folders(self):
+        if not path.isdir(self.page_description_folder):
+            os.mkdir(self.page_description_folder)
+
+        if not path.isdir(self.connection_description_folder):
+            os.mkdir(self.connection_description_folder)
+
+
+def instantiate_template(template: str, params: dict) -> dict:
+    """
+    Replaces ${name} placeholders of template by parameters and parses resulting description.
+    Strings are inserted escaped, so placeholder can be part of JSON string.
+    Raises ValueError if result is not valid JSON.
+    """
+    for name, value in params.items():
+        text = json.dumps(value)[1:-1] if isinstance(value, str) else json.dumps(value)
+        template = template.replace('${' + name + '}', text)
+    return json.loads(template)
+
 
 class PositionAssigner:
     def __init__(self, description: dict):
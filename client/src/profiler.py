@@ -0,0 +1,95 @@
+"""
+Fetches profile of server mainloop( server built with CTRL_PROFILER ).
+
+Prints per-stage statistics and loop utilisation,
+trace of slowest stage executions can be exported to CSV.
+
+Example:
+    python profiler.py 192.168.1.10 9874 --reset --trace trace.csv
+"""
+import argparse
+import csv
+import json
+import socket
+from struct import Struct
+from frameReader import FrameReader
+
+# start( cycles ), duration( cycles ) and stage index
+trace_entry = Struct('<IIB')
+
+
+def request_profile(address: tuple, reset: bool, timeout: float) -> tuple:
+    """
+    Returns (header, trace data) of PROFILE response.
+    """
+    sock = socket.create_connection(address, timeout=timeout)
+    frame_reader = FrameReader()
+    msg = {"CMD": "PROFILE", "VAL": "RESET"} if reset else {"CMD": "PROFILE"}
+    sent = False
+
+    try:
+        while True:
+            data = sock.recv(65536)
+            if not data:
+                raise ConnectionError('server closed connection')
+            frame_reader.feed(data)
+
+            for header, binary in frame_reader.frames():
+                # request is sent after greeting, pushed PAGE messages are skipped
+                if not sent:
+                    sock.sendall(json.dumps(msg).encode())
+                    sent = True
+                    continue
+
+                if 'ERR' in header:
+                    raise RuntimeError(f'server error: {header["ERR"]}( is server built with CTRL_PROFILER? )')
+
+                if 'PROFILE' in header:
+                    return header, binary
+    finally:
+        sock.close()
+
+
+def report(header: dict):
+    to_us = 1e6 / header['CLK']
+    print(f'loop utilisation: {header["UTIL"] / 10:.1f} %')
+    print(f'{"stage":>18} {"count":>10} {"min us":>10} {"avg us":>10} {"max us":>10}')
+    for stage in header['STAGES']:
+        print(f'{stage["NAME"]:>18} {stage["N"]:>10} {stage["MIN"] * to_us:>10.2f} '
+              f'{stage["AVG"] * to_us:>10.2f} {stage["MAX"] * to_us:>10.2f}')
+
+
+def export_trace(header: dict, binary: bytes, file_name: str):
+    to_us = 1e6 / header['CLK']
+    names = [stage['NAME'] for stage in header['STAGES']]
+    entries = [trace_entry.unpack_from(binary, offset) for offset in range(0, len(binary), trace_entry.size)]
+    origin = entries[0][0] if entries else 0
+
+    with open(file_name, 'w', newline='') as file:
+        writer = csv.writer(file)
+        writer.writerow(['start_us', 'duration_us', 'stage'])
+        for start, cycles, stage in entries:
+            # counter wraps around, start is relative to oldest entry( enclosing stage is recorded after nested one )
+            relative = ((start - origin + 0x80000000) & 0xFFFFFFFF) - 0x80000000
+            writer.writerow([f'{relative * to_us:.2f}', f'{cycles * to_us:.2f}', names[stage]])
+
+    print(f'{len(entries)} trace entries written to {file_name}')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Fetches profile of controller server.')
+    parser.add_argument('host')
+    parser.add_argument('port', type=int)
+    parser.add_argument('--reset', action='store_true', help='clear statistics and trace after reading them')
+    parser.add_argument('--trace', help='CSV file for trace of slow stages')
+    parser.add_argument('-t', '--timeout', type=float, default=5., help='seconds to wait for response')
+    args = parser.parse_args()
+
+    header, binary = request_profile((args.host, args.port), args.reset, args.timeout)
+    report(header)
+    if args.trace:
+        export_trace(header, binary, args.trace)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,142 @@
+"""
+Replays captured protocol session( see capture.py ) against server.
+
+Client messages are sent at their original time divided by speed factor.
+Received frames are compared with captured server frames in order and
+timing drift of each response is reported.
+
+Example:
+    python replay.py session.cap 192.168.1.10 9874 --speed 4 --compare headers
+"""
+import argparse
+import selectors
+import socket
+import time
+from capture import read_capture, CLIENT, SERVER
+from frameReader import FrameReader, split_frame, json_length
+
+
+def replay(records: list, address: tuple, speed: float, timeout: float) -> list:
+    """
+    Sends client records to server and returns list of (timestamp, frame) of received frames.
+    Timestamps are scaled back to original speed.
+    """
+    client_records = [(timestamp, payload) for timestamp, direction, payload in records if direction == CLIENT]
+    expected_frames = sum(direction == SERVER for _, direction, _ in records)
+
+    sock = socket.create_connection(address, timeout=10)
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    sock.setblocking(False)
+    selector = selectors.DefaultSelector()
+    selector.register(sock, selectors.EVENT_READ)
+
+    frame_reader = FrameReader()
+    received = []
+    # messages which socket did not accept yet are sent when it becomes writable
+    send_buffer = bytearray()
+    start = time.monotonic()
+    last_receive = start
+    next_record = 0
+
+    while len(received) < expected_frames:
+        now = time.monotonic()
+        while next_record < len(client_records) and client_records[next_record][0] / speed <= now - start:
+            send_buffer += client_records[next_record][1]
+            next_record += 1
+
+        if send_buffer:
+            try:
+                del send_buffer[:sock.send(send_buffer)]
+            except BlockingIOError:
+                pass
+        selector.modify(sock, selectors.EVENT_READ | (selectors.EVENT_WRITE if send_buffer else 0))
+
+        if next_record == len(client_records) and not send_buffer and now - last_receive > timeout:
+            break
+
+        wait = timeout
+        if next_record < len(client_records):
+            wait = max(client_records[next_record][0] / speed - (now - start), 0)
+
+        for _, mask in selector.select(timeout=min(wait, timeout)):
+            if not mask & selectors.EVENT_READ:
+                continue
+            try:
+                data = sock.recv(65536)
+            except BlockingIOError:
+                continue
+            if not data:
+                expected_frames = len(received)
+                break
+            frame_reader.feed(data)
+            last_receive = time.monotonic()
+            for frame in frame_reader.raw_frames():
+                received.append(((last_receive - start) * speed, bytes(frame)))
+
+    selector.close()
+    sock.close()
+    return received
+
+
+def frames_match(expected: bytes, actual: bytes, compare: str) -> bool:
+    if compare == 'full':
+        return expected == actual
+    if compare == 'headers':
+        return split_frame(memoryview(expected))[0] == split_frame(memoryview(actual))[0]
+    return True
+
+
+def describe(frame: bytes) -> str:
+    header_len = json_length(memoryview(frame))
+    text = frame[:header_len].decode(errors='replace')
+    if header_len < len(frame):
+        text += f' + {len(frame) - header_len}B {frame[header_len:header_len + 16].hex()}'
+    return text if len(text) < 120 else text[:117] + '...'
+
+
+def report(records: list, received: list, compare: str, max_diffs: int):
+    expected = [(timestamp, payload) for timestamp, direction, payload in records if direction == SERVER]
+
+    mismatches = 0
+    drifts = []
+    for idx, ((expected_time, expected_frame), (actual_time, actual_frame)) in enumerate(zip(expected, received)):
+        drifts.append(actual_time - expected_time)
+        if frames_match(expected_frame, actual_frame, compare):
+            continue
+        mismatches += 1
+        if mismatches <= max_diffs:
+            print(f'frame {idx} differs:')
+            print(f'  captured: {describe(expected_frame)}')
+            print(f'  replayed: {describe(actual_frame)}')
+
+    print(f'frames captured: {len(expected)}, replayed: {len(received)}, mismatches: {mismatches}')
+    if drifts:
+        drifts_ms = sorted(drift * 1000 for drift in drifts)
+        print(f'timing drift( replayed - captured, original time scale ): '
+              f'mean {sum(drifts_ms) / len(drifts_ms):.2f} ms, '
+              f'median {drifts_ms[len(drifts_ms) // 2]:.2f} ms, '
+              f'min {drifts_ms[0]:.2f} ms, max {drifts_ms[-1]:.2f} ms')
+
+    return mismatches == 0 and len(expected) == len(received)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Replays captured session against controller server.')
+    parser.add_argument('capture')
+    parser.add_argument('host')
+    parser.add_argument('port', type=int)
+    parser.add_argument('-s', '--speed', type=float, default=1., help='speed factor, 2 replays twice as fast')
+    parser.add_argument('-c', '--compare', choices=['full', 'headers', 'none'], default='full',
+                        help='compare whole frames, only JSON headers( ignores values ) or nothing')
+    parser.add_argument('-t', '--timeout', type=float, default=5., help='seconds to wait for missing responses')
+    parser.add_argument('--max-diffs', type=int, default=10, help='number of printed differences')
+    args = parser.parse_args()
+
+    records = read_capture(args.capture)
+    received = replay(records, (args.host, args.port), args.speed, args.timeout)
+    if not report(records, received, args.compare, args.max_diffs):
+        exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,140 @@
+from struct import Struct, error as StructError
+
+
+# values stored raw in layout 2
+raw_formats = {'float': Struct('<f'), 'double': Struct('<d'), 'bool': Struct('<?'), 'u8': Struct('<B')}
+# varint values, signed ones are zigzag encoded
+zigzag_types = {'int32', 'i16', 'fixed'}
+# element count of array in layout 1
+array_length = Struct('<H')
+
+
+class ValueDecoder:
+    """
+    Decodes binary POLL values of one page.
+    Layout 1 is compiled once from widget value types: consecutive fixed width values
+    are merged into single Struct, strings( NUL terminated ) split these runs.
+    Layout 2 starts with enable bitmap followed by zigzag varint signed integers,
+    varint unsigned integers and sequence numbers, raw floats, doubles, bools and u8
+    and varint length prefixed strings.
+    Arrays( element type with '[]' suffix ) are prefixed with element count( uint16 in layout 1,
+    varint in layout 2 ) and decoded as list of elements.
+    Fixed point values are decoded as raw integers, widget applies its scale.
+    """
+    fixed_formats = {'int32': 'iB', 'float': 'fB', 'series': 'IB', 'bool': '?B', 'u8': 'BB',
+                     'i16': 'hB', 'u32': 'IB', 'fixed': 'iB', 'double': 'dB'}
+
+    def __init__(self, value_types: list, layout: int = 1):
+        self.value_types = value_types
+        self.layout = layout
+
+        # list of (Struct, value count) pairs, Struct is None for string value,
+        # array is (element format, None) pair
+        self.steps = []
+        value_format = ''
+        count = 0
+        for value_type in value_types:
+            if value_type in self.fixed_formats:
+                value_format += self.fixed_formats[value_type]
+                count += 1
+                continue
+
+            if count:
+                self.steps.append((Struct('<' + value_format), count))
+                value_format = ''
+                count = 0
+            if value_type.endswith('[]'):
+                self.steps.append((self.fixed_formats[value_type[:-2]][0], None))
+            else:
+                self.steps.append((None, 1))
+
+        if count:
+            self.steps.append((Struct('<' + value_format), count))
+
+    def decode(self, data: bytes) -> list:
+        """
+        Returns list of (value, enabled) pairs, one for each valued widget.
+        Raises ValueError if data do not match page layout.
+        """
+        if self.layout == 2:
+            return self._decode_v2(data)
+
+        view = memoryview(data)
+        offset = 0
+        values = []
+        try:
+            for layout, count in self.steps:
+                if count is None:
+                    length = array_length.unpack_from(view, offset)[0]
+                    offset += array_length.size
+                    elements = Struct(f'<{length}{layout}')
+                    values.append((list(elements.unpack_from(view, offset)), bool(view[offset + elements.size])))
+                    offset += elements.size + 1
+                    continue
+
+                if layout is None:
+                    end = data.index(0, offset)
+                    values.append((str(view[offset:end], errors='replace'), bool(view[end + 1])))
+                    offset = end + 2
+                    continue
+
+                fields = layout.unpack_from(view, offset)
+                offset += layout.size
+                values.extend(zip(fields[0::2], map(bool, fields[1::2])))
+        except (StructError, IndexError) as error:
+            raise ValueError('Values do not match page layout.') from error
+        finally:
+            view.release()
+
+        return values
+
+    def _decode_v2(self, data: bytes) -> list:
+        offset = (len(self.value_types) + 7) // 8
+        values = []
+        try:
+            for idx, value_type in enumerate(self.value_types):
+                enabled = bool(data[idx // 8] >> (idx % 8) & 1)
+                if value_type.endswith('[]'):
+                    length, offset = read_varint(data, offset)
+                    value = []
+                    for _ in range(length):
+                        element, offset = self._decode_value_v2(value_type[:-2], data, offset)
+                        value.append(element)
+                else:
+                    value, offset = self._decode_value_v2(value_type, data, offset)
+                values.append((value, enabled))
+        except (StructError, IndexError) as error:
+            raise ValueError('Values do not match page layout.') from error
+
+        return values
+
+    @staticmethod
+    def _decode_value_v2(value_type: str, data: bytes, offset: int) -> tuple:
+        if value_type in raw_formats:
+            return raw_formats[value_type].unpack_from(data, offset)[0], offset + raw_formats[value_type].size
+
+        if value_type == 'string':
+            length, offset = read_varint(data, offset)
+            if offset + length > len(data):
+                raise IndexError('string past end of data')
+            return str(data[offset:offset + length], errors='replace'), offset + length
+
+        value, offset = read_varint(data, offset)
+        if value_type in zigzag_types:
+            value = (value >> 1) ^ -(value & 1)  # zigzag
+        return value, offset
+
+
+def read_varint(data: bytes, offset: int) -> tuple:
+    """
+    Reads unsigned LEB128 varint, returns (value, offset after varint).
+    """
+    value = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7f) << shift
+        if byte < 0x80:
+            return value, offset
+        shift += 7
@@ -13,15 +13,257 @@
 #include <stdint.h>
 
 #define ERR_PAGE_ID UINT16_MAX
+#define ALL_PAGES_ID ( UINT16_MAX - 1 )
+#define ERR_CONNECTION_ID UINT16_MAX
+
+/**
+ * Maximal count of JSON tokens used for parsing single message.
+ * Can be overridden by configuration profile in lwipopts.h.
+ */
+#ifndef MAX_TOKEN_COUNT
 #define MAX_TOKEN_COUNT 256
+#endif
+
+/**
+ * Maximal capacity of preallocated string widget.
+ * Old value of such widget is passed to callback in scratch buffer of this size.
+ */
+#ifndef CTRL_MAX_STRING_CAPACITY
+#define CTRL_MAX_STRING_CAPACITY 64
+#endif
+
+/**
+ * When set to 1, too long strings received for preallocated string widgets are truncated,
+ * otherwise SET command is rejected.
+ */
+#ifndef CTRL_STRING_TRUNCATE
+#define CTRL_STRING_TRUNCATE 0
+#endif
+
+/**
+ * Maximal count of concurrently opened connections.
+ * One PCB is kept in reserve for connections which are still closing
+ * and one is used by MQTT bridge when enabled.
+ * Can be overridden by configuration profile in lwipopts.h.
+ */
+#ifndef CTRL_MAX_CONNECTIONS
+#define CTRL_MAX_CONNECTIONS ( MEMP_NUM_TCP_PCB - 1 - CTRL_MQTT_BRIDGE )
+#endif
+
+/**
+ * Bytes of SERIES response besides samples( length prefix, JSON header and batch header ).
+ */
+#define SERIES_RESPONSE_OVERHEAD 28
+
+/**
+ * Maximal count of samples sent in response to single SERIES command.
+ * Whole response( 8 bytes per sample ) must fit into TCP_SND_BUF, which is checked at compile time.
+ * Batch is further limited by free space of send buffer, client continues from returned sequence number.
+ */
+#ifndef CTRL_MAX_SERIES_BATCH
+#define CTRL_MAX_SERIES_BATCH ( ( TCP_SND_BUF - SERIES_RESPONSE_OVERHEAD ) / 8 )
+#endif
+
+/**
+ * Minimal period in ms between announcements of new series samples.
+ * Sequence number of series in POLL response is updated at most this often,
+ * so fast sampling does not serialize values of page again for every sample.
+ */
+#ifndef CTRL_SERIES_NOTIFY_PERIOD
+#define CTRL_SERIES_NOTIFY_PERIOD 50
+#endif
+
+/**
+ * Maximal rate of UDP value stream in datagrams per second.
+ */
+#ifndef CTRL_MAX_STREAM_RATE
+#define CTRL_MAX_STREAM_RATE 100
+#endif
+
+/**
+ * Period in ms after which unchanged values are streamed again,
+ * so client can distinguish static page from lost stream.
+ */
+#ifndef CTRL_STREAM_KEEPALIVE
+#define CTRL_STREAM_KEEPALIVE 500
+#endif
+
+/**
+ * When set to 1, PAGE message and greeting carry hash of page description
+ * and values of page, so client can show new page without another POLL.
+ */
+#ifndef CTRL_PAGE_SNAPSHOT
+#define CTRL_PAGE_SNAPSHOT 1
+#endif
+
+/**
+ * When set to 1, application promises to change values only with setters or mark_dirty,
+ * so snapshots of pages stay cached across mainloop iterations.
+ * Otherwise all pages are treated as changed after each idle callback.
+ */
+#ifndef CTRL_SETTERS_ONLY
+#define CTRL_SETTERS_ONLY 0
+#endif
+
+/**
+ * Binary layouts of values in POLL response.
+ * Layout 1 sends value and enable byte for each widget and NUL terminated strings,
+ * layout 2 sends enable bitmap, varint integers and length prefixed strings.
+ * Connection starts with layout 1 and switches with LAYOUT command.
+ */
+#define POLL_LAYOUT_V1 1
+#define POLL_LAYOUT_V2 2
+#define POLL_LAYOUT_MAX POLL_LAYOUT_V2
+
+/**
+ * When set to 1, widgets can hold double values.
+ * This doubles size of w_val_t, so it is disabled by default.
+ */
+#ifndef CTRL_DOUBLE_VALUES
+#define CTRL_DOUBLE_VALUES 0
+#endif
+
+/**
+ * When set to 1, update callbacks of SET commands run from mainloop instead of lwIP receive callback.
+ * Values are stored immediately, response is sent after callback finishes.
+ */
+#ifndef CTRL_DEFERRED_CALLBACKS
+#define CTRL_DEFERRED_CALLBACKS 0
+#endif
+
+/**
+ * Count of SET commands waiting for their callbacks.
+ * When queue is full, further messages stay in receive buffer.
+ */
+#ifndef CTRL_WORK_QUEUE_LENGTH
+#define CTRL_WORK_QUEUE_LENGTH 4
+#endif
+
+/**
+ * When set to 1, cycles spent in stages of mainloop are measured and reported by PROFILE command.
+ */
+#ifndef CTRL_PROFILER
+#define CTRL_PROFILER 0
+#endif
+
+/**
+ * Maximal scale( count of decimal digits ) of fixed point value.
+ */
+#define FIXED_MAX_SCALE 9
 
 enum value_type
 {
 	_int,
 	_float,
-	_string
+	_string,
+	_series,
+	_bool,
+	_u8,
+	_i16,
+	_u32,
+	_fixed,
+	_array,
+#if CTRL_DOUBLE_VALUES
+	_double,
+#endif
 };
 
+/**
+ * Contiguous typed buffer backing array widget.
+ * Whole array shares single enable flag and is serialized as one block.
+ */
+typedef struct array
+{
+	/**
+	 * Buffer of length elements of element_type.
+	 */
+	void *data;
+
+	/**
+	 * Count of elements.
+	 */
+	uint16_t length;
+
+	/**
+	 * Type of elements( enum value_type ), only numeric types are supported.
+	 * Scale of fixed point elements is taken from scale of widget.
+	 */
+	uint8_t element_type;
+} array_t;
+
+/**
+ * Single timestamped sample of series widget.
+ */
+typedef struct series_sample
+{
+	/**
+	 * Time of sample in ms( sys_now ).
+	 */
+	uint32_t timestamp;
+
+	/**
+	 * Sampled value.
+	 */
+	float value;
+} series_sample_t;
+
+/**
+ * Ring buffer of samples backing series widget.
+ * Storage is provided by user, e.g.:
+ * static series_sample_t samples[ 256 ];
+ * static series_t series = { .samples = samples, .capacity = 256 };
+ */
+typedef struct series
+{
+	/**
+	 * Storage of ring buffer.
+	 */
+	series_sample_t *samples;
+
+	/**
+	 * Count of samples in storage.
+	 */
+	uint16_t capacity;
+
+	/**
+	 * Index where next sample is written.
+	 */
+	uint16_t head;
+
+	/**
+	 * Sequence number of next sample( count of all pushed samples ).
+	 */
+	uint32_t seq;
+
+	/**
+	 * Sequence number which widget was last marked changed with, maintained by server.
+	 */
+	uint32_t announced_seq;
+} series_t;
+
+/**
+ * Filter suppressing insignificant changes of numeric widget( e.g. noisy ADC reading ).
+ * Filters are applied by numeric setters( set_int, set_float, set_u8, ... ), values set by client are never filtered.
+ */
+typedef struct widget_filter
+{
+	/**
+	 * Change of value smaller than deadband is dropped( value is not stored ), 0 disables deadband.
+	 */
+	float deadband;
+
+	/**
+	 * When 1, deadband is fraction of magnitude of current value instead of absolute change.
+	 */
+	uint8_t relative;
+
+	/**
+	 * Minimal time between published changes in ms, 0 disables limit.
+	 * Change arriving sooner is held and stored into page only after interval elapses.
+	 */
+	uint16_t min_interval;
+} widget_filter_t;
+
 /**
  * Structure for representing value of various widgets.
  */
@@ -35,17 +277,42 @@ typedef struct _widget_value
 		int32_t int_val;
 		float float_val;
 		char *string_val;
+		series_t *series_val;
+		array_t *array_val;
+		uint8_t bool_val;
+		uint8_t u8_val;
+		int16_t i16_val;
+		uint32_t u32_val;
+		int32_t fixed_val;
+#if CTRL_DOUBLE_VALUES
+		double double_val;
+#endif
 	} value;
 
 	/**
-	 * Type of value.
+	 * Type of value( enum value_type ), stored in single byte to keep values array small.
 	 */
-	enum value_type val_type;
+	uint8_t val_type;
 
 	/**
 	 * Encodes whether widget is enabled.
 	 */
 	uint8_t enabled;
+
+	union
+	{
+		/**
+		 * Capacity of string storage pointed by string_val( without trailing '\0' ).
+		 * Strings with capacity are copied in place, otherwise
+		 * new string is allocated on heap for each SET command.
+		 */
+		uint16_t capacity;
+
+		/**
+		 * Count of decimal digits of fixed point value, fixed_val holds value * 10^scale.
+		 */
+		uint8_t scale;
+	};
 } w_val_t;
 
 
@@ -54,6 +321,11 @@ typedef struct _widget_value
  */
 typedef struct page
 {
+	/**
+	 * Id of page( index in server.pages ).
+	 */
+	uint16_t page_id;
+
 	/**
 	 * Representation of page UI.
 	 */
@@ -65,6 +337,28 @@ typedef struct page
 	 */
 	uint16_t page_desc_len;
 
+	/**
+	 * FNV-1a hash of page_description, client uses it to validate cached description.
+	 * Hash of template page continues over its parameters.
+	 */
+	uint32_t desc_hash;
+
+	/**
+	 * Parameters of template page as JSON object, NULL for ordinary page.
+	 * page_description of template page is template shared with other instances.
+	 */
+	const char *params;
+
+	/**
+	 * Length of params.
+	 */
+	uint16_t params_len;
+
+	/**
+	 * FNV-1a hash of page_description alone, client caches template once under this hash.
+	 */
+	uint32_t template_hash;
+
 	/**
 	 * Widget values array.
 	 */
@@ -80,6 +374,58 @@ typedef struct page
 	 */
 	void (*update_callback)( uint16_t widget_id,
 							 w_val_t *old_value );
+
+	/**
+	 * Serialized values shared by connections displaying page, one for each layout.
+	 */
+	struct snapshot *snapshot[ POLL_LAYOUT_MAX ];
+
+	/**
+	 * Bitmap of widgets changed since last clear_dirty( bit per widget ).
+	 */
+	uint8_t *dirty;
+
+	/**
+	 * Incremented every time values of page change.
+	 */
+	uint32_t generation;
+
+	/**
+	 * Sequence counter of interrupt producers, odd while producer writes values.
+	 */
+	volatile uint32_t sequence;
+
+	/**
+	 * Producer sequence already recorded in generation and dirty bitmaps.
+	 */
+	uint32_t seen_sequence;
+
+	/**
+	 * Set when samples were pushed to series of page since they were last announced.
+	 */
+	uint8_t series_pending;
+
+	/**
+	 * Time of last announcement of series samples( sys_now ).
+	 */
+	uint32_t series_time;
+
+	/**
+	 * Filters of widgets( array of widget_count ), NULL if page has no filters.
+	 */
+	const widget_filter_t *filters;
+
+	/**
+	 * Time of last publication and held changes of filtered widgets.
+	 */
+	struct filter_state *filter_state;
+
+#if CTRL_MQTT_BRIDGE
+	/**
+	 * Bitmap of widgets not yet published by MQTT bridge.
+	 */
+	uint8_t *mqtt_dirty;
+#endif
 } page_t;
 
 /**
@@ -115,7 +461,23 @@ typedef enum connection_flags
 	/**
 	 * Connection in process of closing.
 	 */
-	C_CLOSING = ( 1 << 4 )
+	C_CLOSING = ( 1 << 4 ),
+
+	/**
+	 * Page of connection was changed outside of its SET command
+	 * and PAGE message needs to be pushed to client.
+	 */
+	C_PAGE_PENDING = ( 1 << 5 ),
+
+	/**
+	 * header is allocated on heap and needs to be freed in sent callback
+	 */
+	C_HEADER_ALLOCATED = ( 1 << 6 ),
+
+	/**
+	 * Only part of message could be queued, stream is out of sync and connection is aborted.
+	 */
+	C_BROKEN = ( 1 << 7 )
 } connection_flag_t;
 
 
@@ -124,11 +486,43 @@ typedef enum connection_flags
  */
 typedef struct connection
 {
+	/**
+	 * Next connection in list of opened connections.
+	 */
+	struct connection *next;
+
+	/**
+	 * PCB of connection.
+	 */
+	struct tcp_pcb *pcb;
+
+	/**
+	 * Received data waiting for processing.
+	 * Message is processed only when previous response was acknowledged.
+	 */
+	struct pbuf *rx;
+
+	/**
+	 * Unique id of connection.
+	 */
+	uint16_t id;
+
 	/**
 	 * Id of page which is currently displayed by client.
 	 */
 	uint16_t current_page_id;
 
+	/**
+	 * Static header sent before response( may be NULL ).
+	 * This needs to stay intact until ACK is received.
+	 */
+	const char *header;
+
+	/**
+	 * Length of header.
+	 */
+	uint16_t header_len;
+
 	/**
 	 * Pointer to response message.
 	 * This needs to stay intact until ACK is received.
@@ -140,12 +534,97 @@ typedef struct connection
 	 */
 	uint16_t response_len;
 
+	/**
+	 * Snapshot referenced by response, released after ACK.
+	 */
+	struct snapshot *snapshot;
+
+	/**
+	 * Count of sent bytes( including prefix ) waiting for ACK.
+	 */
+	uint16_t unacked;
+
+	/**
+	 * Binary layout of values sent to connection.
+	 */
+	uint8_t layout;
+
+	/**
+	 * Page whose description is sent next in response to GET ALL,
+	 * ERR_PAGE_ID when no GET ALL is in progress.
+	 */
+	uint16_t next_description;
+
+	/**
+	 * UDP port of client receiving value stream, 0 if stream is disabled.
+	 */
+	uint16_t stream_port;
+
+	/**
+	 * Period of value stream in ms.
+	 */
+	uint16_t stream_period;
+
+	/**
+	 * Time when last datagram was sent( sys_now ).
+	 */
+	uint32_t stream_last;
+
+	/**
+	 * Sequence number of next datagram.
+	 */
+	uint32_t stream_seq;
+
+	/**
+	 * Page and its generation streamed in last datagram.
+	 */
+	uint16_t stream_page_id;
+	uint32_t stream_generation;
+
 	/**
 	 * Connection state.
 	 */
 	connection_flag_t flags;
 } connection_t;
 
+/**
+ * Single validated [ widget_id, value ] pair of batch SET command.
+ */
+typedef struct set_pair
+{
+	/**
+	 * Id of modified widget.
+	 */
+	uint16_t widget_id;
+
+	/**
+	 * Index of modified element of array widget.
+	 */
+	uint16_t index;
+
+	/**
+	 * Parsed value, heap string is owned by pair until batch is applied.
+	 * Element of array widget is stored as value of element type.
+	 */
+	w_val_t new_value;
+
+	/**
+	 * Value of string widget with capacity, points inside received message.
+	 */
+	const char *text;
+	uint16_t text_len;
+
+	/**
+	 * Value before batch was applied, passed to callback.
+	 */
+	w_val_t old_value;
+
+	/**
+	 * Storage of old value of string widget with capacity( NULL for other widgets ).
+	 */
+	char *old_string;
+} set_pair_t;
+
 /**
  * Structure for staring internal server data and pages.
  */
@@ -168,6 +647,21 @@ struct ctrl_server
 	 */
 	uint16_t initial_page;
 
+	/**
+	 * List of opened connections.
+	 */
+	connection_t *connections;
+
+	/**
+	 * Number of currently opened connections.
+	 */
+	uint16_t connection_count;
+
+	/**
+	 * Id which will be assigned to next connection.
+	 */
+	uint16_t next_connection_id;
+
 	/**
 	 * Server is up.
 	 */
@@ -176,6 +670,7 @@ struct ctrl_server
 	/**
 	 * When calling API calls from callback this decides what
 	 * connection should be modified.
+	 * NULL outside of message processing.
 	 */
 	connection_t *currently_handled_connection;
 
@@ -184,16 +679,62 @@ struct ctrl_server
 	 */
 	w_val_t old_value;
 
+	/**
+	 * Storage of old value of string widget with capacity.
+	 */
+	char old_string[ CTRL_MAX_STRING_CAPACITY + 1 ];
+
 	/**
 	 * Id of widget which got modified.
 	 */
 	uint16_t widget_id;
 
+	/**
+	 * Index of modified element when widget is array.
+	 */
+	uint16_t array_index;
+
+	/**
+	 * Page of widget which got modified.
+	 */
+	uint16_t changed_page_id;
+
+	/**
+	 * Validated pairs of batch SET command.
+	 */
+	set_pair_t *batch;
+
+	/**
+	 * Count of pairs in batch.
+	 */
+	uint16_t batch_len;
+
 	/**
 	 * Page requested by GET command.
 	 */
 	uint16_t requested_page;
 
+	/**
+	 * First sample requested by SERIES command.
+	 */
+	uint32_t series_since;
+
+	/**
+	 * Layout requested by LAYOUT command.
+	 */
+	uint8_t layout;
+
+	/**
+	 * UDP port and rate requested by STREAM command.
+	 */
+	uint16_t stream_port;
+	uint16_t stream_rate;
+
+	/**
+	 * Set when PROFILE command asked to clear statistics.
+	 */
+	uint8_t profile_reset;
+
 	/**
 	 * Callback called each processing cycle.
 	 */
@@ -224,6 +765,24 @@ add_page( const char *page_description,
 								   w_val_t *old_value ) );
 
 
+/**
+ * Registers new page instantiated from template shared by several pages.
+ * Template is description with ${name} placeholders, which client replaces by values of params.
+ * Neither template nor params are copied, so both must stay valid( e.g. string literals ).
+ * @param page_template UI description with placeholders, same pointer for all instances.
+ * @param params Parameters of this instance as JSON object, e.g. {"n":3,"name":"Motor 3"}.
+ * @see add_page
+ * @return page_id of newly added page or ERR_PAGE_ID on memory error.
+ */
+uint16_t
+add_template_page( const char *page_template,
+				   const char *params,
+				   w_val_t *page_content,
+				   uint16_t widget_count,
+				   void (*update_callback)( uint16_t widget_id,
+											w_val_t *old_value ) );
+
+
 /**
  * Registers callback which will be called each processing loop from mainloop.
  * @param idle_callback Callback.
@@ -235,10 +794,223 @@ void register_idle_callback( void (*idle_callback)( void ) );
  * Changes displayed page.
  * @param page_id Id of new page.
  * @note Can only be called from change_value callback.
+ * When value was changed by MQTT bridge, there is no connection and call has no effect.
  */
 void change_page( uint16_t page_id );
 
 
+/**
+ * Changes displayed page of all connections.
+ * @param page_id Id of new page.
+ * @note Can be called from anywhere except interrupts.
+ */
+void change_page_all( uint16_t page_id );
+
+
+/**
+ * Changes displayed page of all connections currently displaying page from_page_id.
+ * @param from_page_id Id of page which should be replaced.
+ * @param page_id Id of new page.
+ * @note Can be called from anywhere except interrupts.
+ */
+void change_page_from( uint16_t from_page_id, uint16_t page_id );
+
+
+/**
+ * Changes displayed page of single connection.
+ * @param connection_id Id of connection obtained by current_connection().
+ * @param page_id Id of new page.
+ * @return ERR_OK on success, ERR_ARG if connection is already closed.
+ * @note Can be called from anywhere except interrupts.
+ */
+err_t change_connection_page( uint16_t connection_id, uint16_t page_id );
+
+
+/**
+ * Gets id of connection which triggered callback.
+ * @return Connection id or ERR_CONNECTION_ID if called outside of change_value callback.
+ */
+uint16_t current_connection( void );
+
+
+/**
+ * Gets index of element changed by client, when callback was triggered by array widget.
+ * Old value passed to callback is value of this element.
+ * @return Element index, meaningful only inside change_value callback of array widget.
+ */
+uint16_t changed_index( void );
+
+
+/**
+ * Gets id of page whose widget was changed, so instances of template page can share callback.
+ * @return Page id, meaningful only inside change_value callback.
+ */
+uint16_t changed_page( void );
+
+
+/**
+ * Sets value of int widget.
+ * @param page_id Id of page.
+ * @param widget_id Id of widget.
+ * @param value New value.
+ * @return ERR_OK on success, ERR_ARG on invalid id or widget of other type.
+ * @note Setting same value does not mark widget as changed.
+ */
+err_t set_int( uint16_t page_id, uint16_t widget_id, int32_t value );
+
+
+/**
+ * Sets value of float widget.
+ * @see set_int
+ */
+err_t set_float( uint16_t page_id, uint16_t widget_id, float value );
+
+
+/**
+ * Sets value of bool widget( any non-zero value is stored as 1 ).
+ * @see set_int
+ */
+err_t set_bool( uint16_t page_id, uint16_t widget_id, uint8_t value );
+
+
+/**
+ * Sets value of u8 widget.
+ * @see set_int
+ */
+err_t set_u8( uint16_t page_id, uint16_t widget_id, uint8_t value );
+
+
+/**
+ * Sets value of i16 widget.
+ * @see set_int
+ */
+err_t set_i16( uint16_t page_id, uint16_t widget_id, int16_t value );
+
+
+/**
+ * Sets value of u32 widget.
+ * @see set_int
+ */
+err_t set_u32( uint16_t page_id, uint16_t widget_id, uint32_t value );
+
+
+/**
+ * Sets value of fixed point widget.
+ * @param value Value multiplied by 10^scale of widget, e.g. 1234 is 1.234 for scale 3.
+ * @see set_int
+ */
+err_t set_fixed( uint16_t page_id, uint16_t widget_id, int32_t value );
+
+
+#if CTRL_DOUBLE_VALUES
+/**
+ * Sets value of double widget.
+ * @see set_int
+ */
+err_t set_double( uint16_t page_id, uint16_t widget_id, double value );
+#endif
+
+
+/**
+ * Sets value of string widget.
+ * @param value New string( may be NULL ). Server does not take ownership of string
+ * and previous string is not freed.
+ * If widget has capacity, string is copied to widget storage instead.
+ * @return ERR_OK on success, ERR_ARG on invalid id or widget of other type,
+ * ERR_VAL if string does not fit into capacity( and truncation is disabled ).
+ * @see set_int
+ */
+err_t set_string( uint16_t page_id, uint16_t widget_id, char *value );
+
+
+/**
+ * Copies elements into array widget, widget is marked dirty only if some element differs.
+ * @param first Index of first written element.
+ * @param count Count of written elements.
+ * @param values Elements of element type of array.
+ * @return ERR_OK on success, ERR_ARG on invalid id, widget of other type or range past end of array.
+ * @see set_int
+ */
+err_t set_array( uint16_t page_id, uint16_t widget_id, uint16_t first, uint16_t count, const void *values );
+
+
+/**
+ * Enables or disables widget.
+ * @see set_int
+ */
+err_t set_enabled( uint16_t page_id, uint16_t widget_id, uint8_t enabled );
+
+
+/**
+ * Marks widget as changed after value was written directly to values array.
+ * @param page_id Id of page.
+ * @param widget_id Id of widget.
+ */
+void mark_dirty( uint16_t page_id, uint16_t widget_id );
+
+
+/**
+ * Checks whether widget changed since last clear_dirty.
+ * @return 1 if widget changed, 0 otherwise.
+ */
+uint8_t is_dirty( uint16_t page_id, uint16_t widget_id );
+
+
+/**
+ * Clears changes of all widgets of page.
+ * @param page_id Id of page.
+ */
+void clear_dirty( uint16_t page_id );
+
+
+/**
+ * Gets generation of page values, which is incremented on every change.
+ * @param page_id Id of page.
+ */
+uint32_t page_generation( uint16_t page_id );
+
+
+/**
+ * Starts writing values of page from interrupt( or DMA completion ) handler.
+ * Numeric values and array elements are then written directly to values array,
+ * setters and strings must not be used from interrupt.
+ * Serialization running meanwhile is repeated, so clients never see half written values.
+ * @param page_id Id of page.
+ * @note Page must have single producer, which is never interrupted by mainloop.
+ */
+void page_write_begin( uint16_t page_id );
+
+
+/**
+ * Finishes writing started by page_write_begin.
+ * All widgets of page are marked changed later from mainloop.
+ * @param page_id Id of page.
+ */
+void page_write_end( uint16_t page_id );
+
+
+/**
+ * Appends sample to series widget, timestamp is taken from sys_now.
+ * Oldest sample is overwritten when ring buffer is full.
+ * @param page_id Id of page.
+ * @param widget_id Id of series widget.
+ * @param value Sampled value.
+ * @return ERR_OK on success, ERR_ARG on invalid id or widget of other type.
+ * @note Can be called from anywhere except interrupts.
+ */
+err_t series_push( uint16_t page_id, uint16_t widget_id, float value );
+
+
+/**
+ * Registers filters of page widgets, should be called right after add_page.
+ * @param page_id Id of page.
+ * @param filters Array with filter for each widget of page( zeroed filter disables filtering ),
+ * array is not copied and must stay valid.
+ * @return ERR_OK on success, ERR_ARG on invalid page id, ERR_MEM if filter state could not be allocated.
+ */
+err_t set_page_filters( uint16_t page_id, const widget_filter_t *filters );
+
+
 /**
  * Set initial page which will be shown as first to all new connections.
  * @param page_id New page id.
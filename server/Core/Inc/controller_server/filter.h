@@ -0,0 +1,107 @@
+/*
+ * filter.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_FILTER_H_
+#define INC_CONTROLLER_SERVER_FILTER_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * State of filtered widgets of page, allocated by set_page_filters.
+ */
+typedef struct filter_state
+{
+	/**
+	 * Count of changes which are stored but not yet published.
+	 */
+	uint16_t held_count;
+
+	/**
+	 * Bitmap of widgets with held change( bit per widget ).
+	 */
+	uint8_t *held;
+
+	/**
+	 * Held value of each widget, stored into page only when it is published.
+	 */
+	w_val_t *held_value;
+
+	/**
+	 * Time of last published change of each widget( sys_now ).
+	 */
+	uint32_t last_publish[];
+} filter_state_t;
+
+/**
+ * Decision of filter about new value.
+ */
+enum filter_result
+{
+	/**
+	 * Change is insignificant, value is not stored.
+	 */
+	FILTER_DROP,
+
+	/**
+	 * Value is kept by filter and stored into page later by filter_process.
+	 */
+	FILTER_HOLD,
+
+	/**
+	 * Value is stored and published immediately.
+	 */
+	FILTER_PASS
+};
+
+
+/**
+ * Applies filter of widget to changed value.
+ * Dropped change also discards change held before, value returned close to published one.
+ * @param page Page of widget.
+ * @param widget_id Id of int/float widget.
+ * @param current Published value of widget.
+ * @param value New value of widget( different from current ).
+ * @return Decision about new value, widget without filter always passes.
+ */
+enum filter_result filter_value( page_t *page, uint16_t widget_id, float current, float value );
+
+
+/**
+ * Keeps value outside of page until filter_process publishes it,
+ * so serialized values of page stay valid meanwhile.
+ * @param page Page of widget.
+ * @param widget_id Id of widget for which filter_value returned FILTER_HOLD.
+ * @param value New value of widget.
+ */
+void filter_hold( page_t *page, uint16_t widget_id, const w_val_t *value );
+
+
+/**
+ * Discards held change of widget without publishing it.
+ * @param page Page of widget.
+ * @param widget_id Id of widget.
+ */
+void filter_release( page_t *page, uint16_t widget_id );
+
+
+/**
+ * Records publication of widget change, so minimal interval starts again
+ * and held change is no longer pending.
+ * @param page Page of widget.
+ * @param widget_id Id of published widget.
+ */
+void filter_published( page_t *page, uint16_t widget_id );
+
+
+/**
+ * Stores held values whose minimal interval elapsed into their pages and publishes them.
+ * @note Called from mainloop.
+ */
+void filter_process( void );
+
+#endif /* INC_CONTROLLER_SERVER_FILTER_H_ */
@@ -8,35 +8,102 @@
 #ifndef INC_CONTROLLER_SERVER_INPUT_PARSER_H_
 #define INC_CONTROLLER_SERVER_INPUT_PARSER_H_
 
+#include "controller_server.h"
 #include <stdint.h>
 
 enum msg_type
 {
 	MSG_INVALID,
 	MSG_CMD_GET,
+	MSG_CMD_GET_ALL,
 	MSG_CMD_SET,
-	MSG_CMD_POLL
+	MSG_CMD_SET_BATCH,
+	MSG_CMD_POLL,
+	MSG_CMD_SERIES,
+	MSG_CMD_STREAM,
+	MSG_CMD_LAYOUT,
+	MSG_CMD_PROFILE
 };
 
 /**
  * Parses message and stores results of parsing inside global ctrl-server structure.
- * - MSG_INVALID must set response message.
+ * - MSG_INVALID must set response message, also when over MAX_TOKEN_COUNT tokens would be needed for parsing.
  * - MSG_CMD_GET must set requested page id.
+ * - MSG_CMD_GET_ALL simply returns.
  * - MSG_CMD_SET must set new and old value and widget id.
+ * - MSG_CMD_SET_BATCH must validate all pairs and store them in server.batch without modifying any widget.
  * - MSG_CMD_POLL simply returns.
- * @return - JSMN_ERROR_NOMEM on insufficient memory for parsing or if over MAX_TOKEN_COUNT would be needed for parsing.
+ * - MSG_CMD_SERIES must set widget id and requested sequence number.
+ * - MSG_CMD_STREAM must set UDP port and rate of stream.
+ * - MSG_CMD_LAYOUT must set requested layout of values.
+ * - MSG_CMD_PROFILE must set whether statistics are cleared.
+ * @return - JSMN_ERROR_NOMEM on insufficient memory for parsing,
+ * also for SET whose callbacks can not be deferred now( CTRL_DEFERRED_CALLBACKS ).
  * @return - enum msg_type for parsed message.
  */
 int16_t parse_msg( const char *msg, uint16_t msg_len );
 
 
+/**
+ * Stores received value into widget.
+ * Old value must be already copied into server.old_value, old value of preallocated string
+ * is moved into scratch buffer.
+ * @param current_value Value of widget.
+ * @param text Received value( string without quotes ), numbers are parsed up to first invalid character.
+ * @param len Length of text.
+ * @param received_type Type of received value.
+ * @return NULL on success, otherwise error response.
+ */
+const char *store_widget_value( w_val_t *current_value, const char *text, uint16_t len, enum value_type received_type );
+
+
+/**
+ * Stores all values of validated batch into page and marks them changed, old values are kept in pairs.
+ * @param page Page which was displayed when batch was parsed.
+ */
+void store_set_batch( page_t *page );
+
+
+/**
+ * Calls update callback for each pair of stored batch in order of batch.
+ * @param page Page which was displayed when batch was parsed.
+ * @param batch Pairs stored by store_set_batch.
+ * @param batch_len Count of pairs.
+ */
+void notify_set_batch( page_t *page, set_pair_t *batch, uint16_t batch_len );
+
+
+/**
+ * Stores all values of validated batch into page and then calls
+ * update callback for each pair in order of batch.
+ * @param page Page which was displayed when batch was parsed.
+ * @note Batch needs to be released by free_set_batch afterwards.
+ */
+void apply_set_batch( page_t *page );
+
+
+/**
+ * Releases batch parsed by parse_msg together with resources of pairs which were not applied.
+ */
+void free_set_batch( void );
+
+
+/**
+ * Releases batch detached from server.batch together with resources of its pairs.
+ */
+void free_batch( set_pair_t *batch, uint16_t batch_len );
+
+
 #endif /* INC_CONTROLLER_SERVER_INPUT_PARSER_H_ */
 
 /*
  * Example communication
  *
  * --server established--
- * -> { "VERSION": 1, "PAGE": 0 }
+ * -> { "VERSION": 1, "LAYOUT": 2, "PAGE": 0 }
+ *
+ * <- { "CMD": "LAYOUT", "VAL": 2 }
+ * -> { "LAYOUT": 2 }
  *
  * <- { "CMD": "GET", "VAL": { "PAGE": 0 } }
  * -> { "widgets": [ { "type": "button", "text": "Press Me!" } ] }
@@ -44,6 +111,10 @@ int16_t parse_msg( const char *msg, uint16_t msg_len );
  * <- { "CMD": "POLL" }
  * -> { "VAL": [ 1, 1 ] }
  *
+ * <- { "CMD": "GET", "VAL": { "PAGE": "ALL" } }
+ * -> { "DESC": 0, "COUNT": 2, "HASH": "8f3a09c2" }{ "widgets": [ ... ] }
+ * -> { "DESC": 1, "COUNT": 2, "HASH": "01b2c3d4" }{ "widgets": [ ... ] }
+ *
  * <- { "CMD": "SET", "VAL": [ 0, 1 ] }
  * -> { "PAGE": 1 }
  *
@@ -52,5 +123,8 @@ int16_t parse_msg( const char *msg, uint16_t msg_len );
  *
  * <- { "CMD": "SET", "VAL": [ 1, 1 ] }
  * -> { "VAL": [ 1, 0, 1, 0 ] }
+ *
+ * <- { "CMD": "SET", "VAL": [ [ 0, 0 ], [ 1, 0 ] ] }
+ * -> { "VAL": [ 0, 0, 0, 0 ] }
  */
 
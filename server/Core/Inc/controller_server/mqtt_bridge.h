@@ -0,0 +1,73 @@
+/*
+ * mqtt_bridge.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_MQTT_BRIDGE_H_
+#define INC_CONTROLLER_SERVER_MQTT_BRIDGE_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * Prefix of all topics used by bridge.
+ * Values are published to <prefix>/<page_id>/<widget_id>,
+ * values written to <prefix>/<page_id>/<widget_id>/set are applied as SET command.
+ */
+#ifndef CTRL_MQTT_TOPIC_PREFIX
+#define CTRL_MQTT_TOPIC_PREFIX "nucleo"
+#endif
+
+/**
+ * Period of publishing changed values in ms.
+ */
+#ifndef CTRL_MQTT_PUBLISH_PERIOD
+#define CTRL_MQTT_PUBLISH_PERIOD 200
+#endif
+
+/**
+ * When set to 1, changed page is published as single JSON array of all its values
+ * to <prefix>/<page_id> instead of one topic per widget.
+ */
+#ifndef CTRL_MQTT_PER_PAGE
+#define CTRL_MQTT_PER_PAGE 0
+#endif
+
+/**
+ * Maximal length of published payload.
+ */
+#ifndef CTRL_MQTT_PAYLOAD_SIZE
+#define CTRL_MQTT_PAYLOAD_SIZE 256
+#endif
+
+/**
+ * Period of reconnection attempts in ms.
+ */
+#ifndef CTRL_MQTT_RECONNECT_PERIOD
+#define CTRL_MQTT_RECONNECT_PERIOD 5000
+#endif
+
+#if CTRL_MQTT_BRIDGE
+
+/**
+ * Starts bridge, connection to broker is established from mainloop and kept alive.
+ * @param broker Address of broker.
+ * @param port Port of broker( usually 1883 ).
+ * @param client_id MQTT client id, must stay valid while bridge runs.
+ * @return ERR_OK on success, ERR_MEM if MQTT client could not be allocated.
+ * @note Must be called after server_init.
+ */
+err_t mqtt_bridge_start( const ip_addr_t *broker, uint16_t port, const char *client_id );
+
+
+/**
+ * Reconnects to broker and publishes changed values.
+ * @note Called from mainloop.
+ */
+void mqtt_bridge_process( void );
+
+#endif /* CTRL_MQTT_BRIDGE */
+
+#endif /* INC_CONTROLLER_SERVER_MQTT_BRIDGE_H_ */
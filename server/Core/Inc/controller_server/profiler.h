@@ -0,0 +1,111 @@
+/*
+ * profiler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_PROFILER_H_
+#define INC_CONTROLLER_SERVER_PROFILER_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * Count of entries kept in trace ring buffer.
+ */
+#ifndef CTRL_PROFILE_TRACE_LENGTH
+#define CTRL_PROFILE_TRACE_LENGTH 128
+#endif
+
+/**
+ * Stages shorter than threshold( in cycles ) are counted only in statistics,
+ * so idle mainloop iterations do not flush interesting entries out of trace.
+ */
+#ifndef CTRL_PROFILE_TRACE_THRESHOLD
+#define CTRL_PROFILE_TRACE_THRESHOLD 2000
+#endif
+
+/**
+ * Measured stages. Stages are nested, e.g. parse_msg is also counted in ethernetif_input,
+ * which is counted in MX_LWIP_Process and that in mainloop iteration.
+ */
+enum profile_stage
+{
+	PROF_LOOP,
+	PROF_LWIP_PROCESS,
+	PROF_ETHERNET_INPUT,
+	PROF_PARSE,
+	PROF_SERIALIZE,
+	PROF_CALLBACK,
+	PROF_SERVICES,
+	PROF_STAGE_COUNT
+};
+
+#if CTRL_PROFILER
+
+#ifdef __arm__
+#include "main.h"
+#else
+#include <time.h>
+#endif
+
+/**
+ * Starts measuring stage, start time is stored in local variable of given name.
+ */
+#define PROFILE_BEGIN( name ) uint32_t name = profile_now()
+
+/**
+ * Records stage started by PROFILE_BEGIN.
+ */
+#define PROFILE_END( stage, name ) profile_record( stage, name )
+
+/**
+ * @return Current time in cycles( DWT cycle counter ), nanoseconds on host.
+ */
+static inline uint32_t
+profile_now( void )
+{
+#ifdef __arm__
+	return DWT->CYCCNT;
+#else
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint32_t)( now.tv_sec * 1000000000ull + now.tv_nsec );
+#endif
+}
+
+
+/**
+ * Enables cycle counter.
+ */
+void profile_init( void );
+
+
+/**
+ * Adds duration of stage to its statistics and to trace.
+ * @param stage Measured stage( enum profile_stage ).
+ * @param start Time returned by profile_now when stage started.
+ */
+void profile_record( uint8_t stage, uint32_t start );
+
+
+/**
+ * Allocates response to PROFILE command.
+ * Response is JSON with clock frequency, loop utilisation and statistics of stages
+ * followed by trace entries( uint32 start, uint32 cycles, uint8 stage ), oldest first.
+ * Only newest entries which fit into send buffer together with statistics are sent.
+ * @param conn Connection for which response is created.
+ * @param reset Nonzero to clear statistics and trace after they were copied.
+ * @return ERR_OK on success, ERR_MEM if response could not be allocated.
+ */
+err_t set_profile_response( connection_t *conn, uint8_t reset );
+
+#else
+
+#define PROFILE_BEGIN( name )
+#define PROFILE_END( stage, name )
+
+#endif
+
+#endif /* INC_CONTROLLER_SERVER_PROFILER_H_ */
@@ -0,0 +1,35 @@
+/*
+ * series.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_SERIES_H_
+#define INC_CONTROLLER_SERVER_SERIES_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * Allocates response to SERIES command with samples of widget starting from sequence number since.
+ * Response body: widget id( uint16 ), sequence number of first sample( uint32 ), sample count( uint16 )
+ * followed by samples( uint32 timestamp, float value ).
+ * If samples older than since were already overwritten, batch starts with oldest available sample.
+ * @param conn Connection for which response is created.
+ * @param series Series of widget.
+ * @param widget_id Id of widget.
+ * @param since Sequence number of first requested sample.
+ * @return ERR_OK on success, ERR_MEM if response could not be allocated.
+ */
+err_t set_series_response( connection_t *conn, const series_t *series, uint16_t widget_id, uint32_t since );
+
+
+/**
+ * Marks series widgets of page changed if samples were pushed since last announcement,
+ * at most once per CTRL_SERIES_NOTIFY_PERIOD.
+ * @note Called from mainloop and before values of page are serialized.
+ */
+void sync_series( page_t *page );
+
+#endif /* INC_CONTROLLER_SERVER_SERIES_H_ */
@@ -0,0 +1,66 @@
+/*
+ * snapshot.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_SNAPSHOT_H_
+#define INC_CONTROLLER_SERVER_SNAPSHOT_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * Serialized values of page shared by all connections displaying page.
+ * Snapshot is immutable after creation and freed when last reference is released.
+ */
+typedef struct snapshot
+{
+	/**
+	 * Count of references( page cache and connections waiting for ACK ).
+	 */
+	uint16_t ref_count;
+
+	/**
+	 * Generation of page values from which snapshot was created.
+	 */
+	uint32_t generation;
+
+	/**
+	 * Length of data.
+	 */
+	uint16_t len;
+
+	/**
+	 * Binary values as sent in response to POLL( without JSON header ) in layout of snapshot.
+	 */
+	char data[];
+} snapshot_t;
+
+
+/**
+ * Gets snapshot of current page values.
+ * Snapshot is created only if values changed since last call.
+ * @param page Page for which snapshot is requested.
+ * @param layout Binary layout of values( POLL_LAYOUT_V1 or POLL_LAYOUT_V2 ).
+ * @return Referenced snapshot or NULL on memory error.
+ * @note Snapshot must be released by release_snapshot.
+ */
+snapshot_t *acquire_snapshot( page_t *page, uint8_t layout );
+
+
+/**
+ * Releases reference to snapshot.
+ * @param snapshot Snapshot obtained by acquire_snapshot.
+ */
+void release_snapshot( snapshot_t *snapshot );
+
+
+/**
+ * Marks values of page as changed, next acquire_snapshot creates new snapshot.
+ * @param page Page which values changed.
+ */
+void invalidate_snapshot( page_t *page );
+
+#endif /* INC_CONTROLLER_SERVER_SNAPSHOT_H_ */
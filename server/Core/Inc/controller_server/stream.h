@@ -0,0 +1,38 @@
+/*
+ * stream.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_STREAM_H_
+#define INC_CONTROLLER_SERVER_STREAM_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * Creates UDP PCB used for streaming values.
+ * @return ERR_OK on success, ERR_MEM if PCB could not be allocated.
+ */
+err_t stream_init( void );
+
+
+/**
+ * Enables( or disables when rate is 0 ) UDP stream of connection.
+ * Datagrams are sent to remote address of connection.
+ * @param conn Connection which requested stream.
+ * @param port UDP port of client.
+ * @param rate Datagrams per second, limited by CTRL_MAX_STREAM_RATE.
+ */
+void stream_start( connection_t *conn, uint16_t port, uint16_t rate );
+
+
+/**
+ * Sends datagrams to all connections whose stream period elapsed.
+ * Datagram is sent only if values of page changed or keep-alive period elapsed.
+ * @note Called from mainloop.
+ */
+void stream_process( void );
+
+#endif /* INC_CONTROLLER_SERVER_STREAM_H_ */
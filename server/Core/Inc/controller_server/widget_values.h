@@ -0,0 +1,101 @@
+/*
+ * widget_values.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_WIDGET_VALUES_H_
+#define INC_CONTROLLER_SERVER_WIDGET_VALUES_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+/**
+ * Finds widget value of given type.
+ * @return Pointer to value or NULL if ids are out of range or widget has different type.
+ */
+w_val_t *find_value( uint16_t page_id, uint16_t widget_id, enum value_type val_type );
+
+/**
+ * Powers of ten used to scale fixed point values, indexed by scale.
+ */
+extern const uint32_t powers_of_ten[ FIXED_MAX_SCALE + 1 ];
+
+/**
+ * Returns size in bytes of numeric value type( value part of w_val_t ).
+ */
+uint8_t value_size( enum value_type val_type );
+
+/**
+ * Converts numeric value of any type to float( fixed point values are scaled ).
+ * Used by filters and for comparison of values of different types.
+ */
+float numeric_value( const w_val_t *value );
+
+/**
+ * Reads element of array widget as standalone value of element type.
+ * Element has enable flag and scale of array, so it can be parsed and formatted as any other value.
+ */
+void read_array_element( const w_val_t *array_value, uint16_t index, w_val_t *element );
+
+/**
+ * Writes value of element( obtained by read_array_element ) back to array.
+ */
+void write_array_element( w_val_t *array_value, uint16_t index, const w_val_t *element );
+
+/**
+ * Records change of widget value in dirty bitmap and page generation.
+ * @param page Page of widget.
+ * @param widget_id Id of changed widget.
+ */
+void mark_widget_dirty( page_t *page, uint16_t widget_id );
+
+/**
+ * Calls update callback of page after widget was changed by client,
+ * frees old heap string and marks widget as changed.
+ * Old value must be stored in server.old_value.
+ * @param page Page of widget.
+ * @param widget_id Id of changed widget.
+ */
+void notify_widget_change( page_t *page, uint16_t widget_id );
+
+/**
+ * Starts reading values which may be written by interrupt producer.
+ * @return Sequence to be checked by read_retry.
+ */
+static inline uint32_t
+read_begin(
+		const page_t *page )
+{
+	uint32_t sequence = page->sequence;
+	__atomic_thread_fence( __ATOMIC_ACQUIRE );
+	return sequence;
+}
+
+/**
+ * Checks whether values read since read_begin could be torn by producer.
+ * @return Nonzero if values need to be read again.
+ */
+static inline uint8_t
+read_retry(
+		const page_t *page,
+		uint32_t sequence )
+{
+	__atomic_thread_fence( __ATOMIC_ACQUIRE );
+	return ( sequence & 1 ) || page->sequence != sequence;
+}
+
+/**
+ * Marks all widgets of page changed if producer wrote values since last call.
+ * @param sequence Even sequence obtained by read_begin.
+ */
+void sync_producer( page_t *page, uint32_t sequence );
+
+/**
+ * Records writes of interrupt producers and pushed series samples of all pages.
+ * @note Called from mainloop.
+ */
+void sync_producers( void );
+
+#endif /* INC_CONTROLLER_SERVER_WIDGET_VALUES_H_ */
@@ -0,0 +1,100 @@
+/*
+ * work_queue.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#ifndef INC_CONTROLLER_SERVER_WORK_QUEUE_H_
+#define INC_CONTROLLER_SERVER_WORK_QUEUE_H_
+
+#include "controller_server.h"
+#include <stdint.h>
+
+#if CTRL_DEFERRED_CALLBACKS
+
+/**
+ * SET command( or value received by MQTT bridge ) whose values are stored, but callbacks did not run yet.
+ */
+typedef struct work_item
+{
+	/**
+	 * Connection waiting for response, NULL when it was closed meanwhile or value came from MQTT bridge.
+	 */
+	connection_t *conn;
+
+	/**
+	 * Page which was displayed when SET was received.
+	 */
+	uint16_t page_id;
+
+	/**
+	 * Widget and array index of single SET.
+	 */
+	uint16_t widget_id;
+	uint16_t array_index;
+
+	/**
+	 * Old value of single SET, preallocated string is copied into old_string.
+	 */
+	w_val_t old_value;
+	char old_string[ CTRL_MAX_STRING_CAPACITY + 1 ];
+
+	/**
+	 * Stored pairs of batch SET, NULL for single SET.
+	 */
+	set_pair_t *batch;
+	uint16_t batch_len;
+
+	/**
+	 * Set after callbacks ran, only response remains to be sent.
+	 */
+	uint8_t done;
+} work_item_t;
+
+
+/**
+ * @return Nonzero if no more SET commands can be deferred.
+ */
+uint8_t work_full( void );
+
+
+/**
+ * Defers callbacks of SET command which was just stored.
+ * Old value( or server.batch ) is moved into queue.
+ * @param conn Connection which sent command, NULL for value received by MQTT bridge.
+ * @param page_id Page which was displayed when command was received.
+ * @param batch Nonzero for batch SET.
+ * @note Queue must not be full.
+ */
+void work_push( connection_t *conn, uint16_t page_id, uint8_t batch );
+
+
+/**
+ * @return Oldest deferred command or NULL if queue is empty.
+ */
+work_item_t *work_peek( void );
+
+
+/**
+ * Runs callbacks of deferred command and releases its batch.
+ * @note server.currently_handled_connection should be set to connection of item.
+ */
+void work_run( work_item_t *item );
+
+
+/**
+ * Removes oldest command from queue.
+ */
+void work_pop( void );
+
+
+/**
+ * Forgets connection in queued commands, their callbacks still run.
+ * @note Called when connection is freed.
+ */
+void work_detach( connection_t *conn );
+
+#endif
+
+#endif /* INC_CONTROLLER_SERVER_WORK_QUEUE_H_ */
@@ -14,6 +14,8 @@ extern const char *page3;
 
 extern w_val_t values3[];
 
+extern const widget_filter_t filters3[];
+
 extern void page3_callback( uint16_t widget_id, w_val_t *_ );
 
 #endif /* SRC_PAGES_PAGE3_H_ */
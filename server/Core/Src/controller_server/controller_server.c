@@ -7,11 +7,21 @@
 
 #include "controller_server.h"
 #include "input_parser.h"
+#include "snapshot.h"
+#include "widget_values.h"
+#include "series.h"
+#include "stream.h"
+#include "filter.h"
+#include "mqtt_bridge.h"
+#include "work_queue.h"
+#include "profiler.h"
 #include "jsmn.h"
 
 #include <string.h>
 #include <stdio.h>
 
+#define FNV_OFFSET_BASIS 2166136261u
+
 struct ctrl_server server;
 extern ip4_addr_t ipaddr;
 
@@ -25,19 +35,60 @@ static err_t poll_callback( void *arg, struct tcp_pcb *pcb );
 static err_t sent_callback( void *arg, struct tcp_pcb *pcb, uint16_t len );
 static void err_callback( void *arg, err_t err );
 
+static uint16_t message_length( const struct pbuf *p );
+static err_t handle_msg( struct tcp_pcb *pcb, connection_t *conn, const char *msg, uint16_t msg_len );
+static void process_input( struct tcp_pcb *pcb, connection_t *conn );
+static void send_pending( struct tcp_pcb *pcb, connection_t *conn );
+static void push_page( connection_t *conn, uint16_t page_id );
+static err_t set_page_response( connection_t *conn, uint8_t greeting );
+static err_t set_poll_response( connection_t *conn );
 static void send_data( struct tcp_pcb *pcb, connection_t *conn );
+static void send_descriptions( struct tcp_pcb *pcb, connection_t *conn );
 static void close_server( struct tcp_pcb *pcb, connection_t *conn );
+static err_t abort_connection( struct tcp_pcb *pcb, connection_t *conn );
+#if CTRL_DEFERRED_CALLBACKS
+static void process_deferred( void );
+#endif
+#if !CTRL_SETTERS_ONLY
+static void values_changed( void );
+#endif
 
-static char INIT_RESPONSE[] = "{\"VERSION\":1,\"PAGE\":     }"; // 5 blanks to hold up to UINT16_MAX page id's
+static char INIT_RESPONSE[] = "{\"VERSION\":1,\"LAYOUT\":2,\"PAGE\":     }"; // 5 blanks to hold up to UINT16_MAX page id's
 static char ERR_RESPONSE_NOT_JSON[] = "{\"ERR\":\"Not valid JSON.\"}";
+static char ERR_RESPONSE_NO_PAGES[] = "{\"ERR\":\"Server has no pages.\"}";
 static char PAGE_RESPONSE[] = "{\"PAGE\":     }"; // 5 blanks to hold up to UINT16_MAX page id's
 static char POLL_RESPONSE[] = "{\"VAL\":\"BIN\"}"; // followed by raw binary data
+#if CTRL_PAGE_SNAPSHOT
+// page id and hash are formatted, followed by raw binary data as POLL response
+static const char INIT_SNAPSHOT_RESPONSE[] = "{\"VERSION\":1,\"LAYOUT\":2,\"PAGE\":%hu,\"HASH\":\"%08lx\",\"VAL\":\"BIN\"}";
+static const char PAGE_SNAPSHOT_RESPONSE[] = "{\"PAGE\":%hu,\"HASH\":\"%08lx\",\"VAL\":\"BIN\"}";
+// template pages also carry template hash and parameters, so client with cached template does not need GET
+static const char INIT_TEMPLATE_SNAPSHOT_RESPONSE[] = "{\"VERSION\":1,\"LAYOUT\":2,\"PAGE\":%hu,\"HASH\":\"%08lx\","
+													  "\"TEMPLATE\":\"%08lx\",\"PARAMS\":%.*s,\"VAL\":\"BIN\"}";
+static const char PAGE_TEMPLATE_SNAPSHOT_RESPONSE[] = "{\"PAGE\":%hu,\"HASH\":\"%08lx\","
+													  "\"TEMPLATE\":\"%08lx\",\"PARAMS\":%.*s,\"VAL\":\"BIN\"}";
+#endif
+static char STREAM_RESPONSE[] = "{\"STREAM\":\"OK\"}";
+static char LAYOUT_V1_RESPONSE[] = "{\"LAYOUT\":1}";
+static char LAYOUT_V2_RESPONSE[] = "{\"LAYOUT\":2}";
+// header of each description sent in response to GET ALL, followed by description itself
+static const char DESC_HEADER[] = "{\"DESC\":%hu,\"COUNT\":%hu,\"HASH\":\"%08lx\"}";
+// header of template page in response to GET ALL, parameters and closing brace are referenced separately
+static const char DESC_TEMPLATE_HEADER[] = "{\"DESC\":%hu,\"COUNT\":%hu,\"HASH\":\"%08lx\",\"TEMPLATE\":\"%08lx\",\"PARAMS\":";
+static const char DESC_TEMPLATE_END[] = "}";
+// header of template page in response to GET, followed by template
+static const char TEMPLATE_HEADER[] = "{\"TEMPLATE\":\"%08lx\",\"PARAMS\":%.*s}";
 
 void server_init( void )
 {
 	server.pages = NULL;
 	server.page_count = 0;
+	server.connections = NULL;
+	server.connection_count = 0;
+	server.next_connection_id = 0;
 	server.currently_handled_connection = NULL;
+	server.batch = NULL;
+	server.batch_len = 0;
 	server.idle_callback = NULL;
 	server.running = 0;
 	server.initial_page = 0;
@@ -45,13 +96,46 @@ void server_init( void )
 
 static void free_connection( connection_t *conn )
 {
+	connection_t **link = &server.connections;
+	while( *link != conn )
+		link = &( *link )->next;
+	*link = conn->next;
+
 	if( conn->flags & C_ALLOCATED )
 		mem_free( (void *)conn->response );
+	if( conn->flags & C_HEADER_ALLOCATED )
+		mem_free( (void *)conn->header );
+	if( conn->snapshot )
+		release_snapshot( conn->snapshot );
+	if( conn->rx )
+		pbuf_free( conn->rx );
+#if CTRL_DEFERRED_CALLBACKS
+	work_detach( conn );
+#endif
 	mem_free( conn );
+	--server.connection_count;
+}
+
+/**
+ * Computes 32-bit FNV-1a hash of page description.
+ * @param hash Initial hash, FNV_OFFSET_BASIS or hash of preceding text.
+ */
+static uint32_t
+description_hash(
+		uint32_t hash,
+		const char *description,
+		uint16_t len )
+{
+	for( uint16_t idx = 0; idx < len; ++idx )
+	{
+		hash ^= (uint8_t)description[ idx ];
+		hash *= 16777619u;
+	}
+	return hash;
 }
 
 static inline uint16_t
-push_page(
+push_new_page(
 		struct page *new_page )
 {
 	page_t **new_mem = (page_t **)mem_malloc( ( server.page_count + 1 ) * sizeof( *new_mem ) );
@@ -81,21 +165,92 @@ add_page(
 	if( !new_page )
 		return ERR_PAGE_ID;
 
-	uint16_t new_id = push_page( new_page );
+	// MQTT bridge keeps its own bitmap right after user one
+	uint16_t dirty_len = ( widget_count + 7 ) / 8;
+	uint8_t *dirty = (uint8_t *)mem_malloc( dirty_len * ( 1 + CTRL_MQTT_BRIDGE ) );
+	if( !dirty && widget_count )
+	{
+		mem_free( new_page );
+		return ERR_PAGE_ID;
+	}
+
+	uint16_t new_id = push_new_page( new_page );
 	if( new_id == ERR_PAGE_ID )
 	{
+		mem_free( dirty );
 		mem_free( new_page );
 		return ERR_PAGE_ID;
 	}
 
+	memset( dirty, 0, dirty_len );
+#if CTRL_MQTT_BRIDGE
+	// all values are published after bridge connects
+	memset( dirty + dirty_len, 0xFF, dirty_len );
+	new_page->mqtt_dirty = dirty + dirty_len;
+#endif
+
+#ifdef DEBUG
+	for( uint16_t idx = 0; idx < widget_count; ++idx )
+		if( page_content[ idx ].val_type == _string && page_content[ idx ].capacity )
+		{
+			assert( page_content[ idx ].capacity <= CTRL_MAX_STRING_CAPACITY );
+			assert( page_content[ idx ].value.string_val != NULL );
+		}
+		else if( page_content[ idx ].val_type == _series )
+		{
+			assert( page_content[ idx ].value.series_val != NULL );
+			assert( page_content[ idx ].value.series_val->capacity );
+		}
+		else if( page_content[ idx ].val_type == _array )
+		{
+			const array_t *array = page_content[ idx ].value.array_val;
+			assert( array != NULL && array->data != NULL );
+			assert( array->element_type != _string && array->element_type != _series && array->element_type != _array );
+		}
+#endif
+
+	new_page->page_id = new_id;
 	new_page->page_description = page_description;
 	new_page->page_desc_len = strlen( page_description );
+	new_page->desc_hash = description_hash( FNV_OFFSET_BASIS, page_description, new_page->page_desc_len );
+	new_page->template_hash = new_page->desc_hash;
+	new_page->params = NULL;
+	new_page->params_len = 0;
 	new_page->page_content = page_content;
 	new_page->widget_count = widget_count;
 	new_page->update_callback = update_callback;
+	memset( new_page->snapshot, 0, sizeof( new_page->snapshot ) );
+	new_page->dirty = dirty;
+	new_page->generation = 0;
+	new_page->sequence = 0;
+	new_page->seen_sequence = 0;
+	new_page->series_pending = 0;
+	new_page->series_time = 0;
+	new_page->filters = NULL;
+	new_page->filter_state = NULL;
 	return new_id;
 }
 
+uint16_t
+add_template_page(
+		const char *page_template,
+		const char *params,
+		w_val_t *page_content,
+		uint16_t widget_count,
+		void (*update_callback)( uint16_t widget_id, w_val_t *old_value ) )
+{
+	uint16_t page_id = add_page( page_template, page_content, widget_count, update_callback );
+	if( page_id == ERR_PAGE_ID )
+		return ERR_PAGE_ID;
+
+	// template is only referenced, instance differs from other instances by hash of its parameters
+	page_t *page = server.pages[ page_id ];
+	page->params = params;
+	page->params_len = strlen( params );
+	page->desc_hash = description_hash( page->template_hash, params, page->params_len );
+	return page_id;
+}
+
 void set_start_page( uint16_t page_id )
 {
 #ifdef DEBUG
@@ -117,11 +272,181 @@ change_page(
 {
 	connection_t *conn = server.currently_handled_connection;
 
+	// value changed by MQTT bridge, there is no connection whose page could change
+	if( !conn )
+		return;
+
+	conn->current_page_id = page_id;
+}
+
+void
+change_page_all(
+		uint16_t page_id )
+{
+	for( connection_t *conn = server.connections; conn; conn = conn->next )
+		push_page( conn, page_id );
+}
+
+void
+change_page_from(
+		uint16_t from_page_id,
+		uint16_t page_id )
+{
+	for( connection_t *conn = server.connections; conn; conn = conn->next )
+		if( conn->current_page_id == from_page_id )
+			push_page( conn, page_id );
+}
+
+err_t
+change_connection_page(
+		uint16_t connection_id,
+		uint16_t page_id )
+{
+	for( connection_t *conn = server.connections; conn; conn = conn->next )
+		if( conn->id == connection_id )
+		{
+			push_page( conn, page_id );
+			return ERR_OK;
+		}
+
+	return ERR_ARG;
+}
+
+uint16_t current_connection( void )
+{
+	if( !server.currently_handled_connection )
+		return ERR_CONNECTION_ID;
+
+	return server.currently_handled_connection->id;
+}
+
+uint16_t changed_index( void )
+{
+	return server.array_index;
+}
+
+uint16_t changed_page( void )
+{
+	return server.changed_page_id;
+}
+
+/**
+ * Changes page of connection and schedules PAGE message.
+ * @note When connection is handling SET command, PAGE message is sent as response to it.
+ */
+static void
+push_page(
+		connection_t *conn,
+		uint16_t page_id )
+{
 #ifdef DEBUG
-	assert( conn != NULL ); // can't call change_page outside of value change callback
+	assert( page_id < server.page_count );
 #endif
 
+	if( conn->flags & C_CLOSING )
+		return;
+
 	conn->current_page_id = page_id;
+
+	if( conn == server.currently_handled_connection )
+		return;
+
+	conn->flags |= C_PAGE_PENDING;
+
+	// connection is waiting for ACK or response could not be allocated,
+	// PAGE is sent from sent or poll callback
+	if( !( conn->flags & C_IDLE ) )
+		return;
+
+	if( set_page_response( conn, 0 ) != ERR_OK )
+		return;
+
+	conn->flags &= ~( C_IDLE | C_PAGE_PENDING );
+	send_data( conn->pcb, conn );
+	tcp_output( conn->pcb );
+}
+
+#if CTRL_PAGE_SNAPSHOT
+/**
+ * Allocates PAGE message( or greeting ) carrying description hash and values of current page.
+ * @return ERR_OK on success, ERR_MEM if header or snapshot could not be allocated.
+ */
+static err_t
+set_page_snapshot_response(
+		connection_t *conn,
+		uint8_t greeting )
+{
+	page_t *page = server.pages[ conn->current_page_id ];
+	const char *format = greeting ? INIT_SNAPSHOT_RESPONSE : PAGE_SNAPSHOT_RESPONSE;
+	if( page->params )
+		format = greeting ? INIT_TEMPLATE_SNAPSHOT_RESPONSE : PAGE_TEMPLATE_SNAPSHOT_RESPONSE;
+
+	snapshot_t *snapshot = acquire_snapshot( page, conn->layout );
+	if( !snapshot )
+		return ERR_MEM;
+
+	// formatted page id( up to 5 digits ) and hashes( 8 digits ) are longer than conversion specifiers by at most 8
+	uint16_t header_size = strlen( format ) + 8 + page->params_len;
+	char *header = (char *)mem_malloc( header_size );
+	if( !header )
+	{
+		release_snapshot( snapshot );
+		return ERR_MEM;
+	}
+
+	conn->header = header;
+	if( page->params )
+		conn->header_len = snprintf( header, header_size, format, conn->current_page_id, (unsigned long)page->desc_hash,
+									 (unsigned long)page->template_hash, (int)page->params_len, page->params );
+	else
+		conn->header_len = snprintf( header, header_size, format, conn->current_page_id, (unsigned long)page->desc_hash );
+	conn->response = snapshot->data;
+	conn->response_len = snapshot->len;
+	conn->snapshot = snapshot;
+	conn->flags |= C_HEADER_ALLOCATED;
+
+	return ERR_OK;
+}
+#endif
+
+/**
+ * Allocates PAGE message( or greeting ) with current page of connection as response.
+ * Values of page are attached when CTRL_PAGE_SNAPSHOT is enabled and memory allows,
+ * otherwise plain message is sent and client POLLs values.
+ * @param greeting 1 for first message of connection carrying protocol version.
+ * @return ERR_OK on success, ERR_MEM if message could not be allocated.
+ */
+static err_t
+set_page_response(
+		connection_t *conn,
+		uint8_t greeting )
+{
+#if CTRL_PAGE_SNAPSHOT
+	if( set_page_snapshot_response( conn, greeting ) == ERR_OK )
+		return ERR_OK;
+#endif
+
+	const char *template = greeting ? INIT_RESPONSE : PAGE_RESPONSE;
+	uint16_t len = greeting ? sizeof( INIT_RESPONSE ) - 1 : sizeof( PAGE_RESPONSE ) - 1; // -1 for trailing '\0'
+
+	char *resp = (char *)mem_malloc( len );
+
+	if( !resp )
+		return ERR_MEM;
+
+	memcpy( resp, template, len );
+
+	char buff[ 6 ];
+	snprintf( buff, sizeof( buff ), "%5hu", conn->current_page_id );
+
+	// page id is placed over blanks before closing brace
+	memcpy( resp + len - sizeof( buff ), buff, sizeof( buff ) - 1 );
+
+	conn->response = resp;
+	conn->response_len = len;
+	conn->flags |= C_ALLOCATED;
+
+	return ERR_OK;
 }
 
 err_t mainloop( void )
@@ -162,6 +487,13 @@ _mainloop_init( void )
 
 	tcp_accept( listen_pcb, new_conn_callback );
 
+	// server works without value stream, clients just keep polling
+	stream_init();
+
+#if CTRL_PROFILER
+	profile_init();
+#endif
+
 	server.running = 1;
 
 	return ERR_OK;
@@ -181,10 +513,37 @@ static err_t _mainloop( void )
 {
 	while( server.running )
 	{
+		PROFILE_BEGIN( loop_start );
+
+		PROFILE_BEGIN( lwip_start );
 		MX_LWIP_Process();
+		PROFILE_END( PROF_LWIP_PROCESS, lwip_start );
+
+		PROFILE_BEGIN( services_start );
+		filter_process();
+
+		sync_producers();
+
+#if CTRL_DEFERRED_CALLBACKS
+		process_deferred();
+#endif
+
+		stream_process();
+
+#if CTRL_MQTT_BRIDGE
+		mqtt_bridge_process();
+#endif
+		PROFILE_END( PROF_SERVICES, services_start );
 
 		if( server.idle_callback )
+		{
 			server.idle_callback();
+#if !CTRL_SETTERS_ONLY
+			values_changed();
+#endif
+		}
+
+		PROFILE_END( PROF_LOOP, loop_start );
 	}
 	return ERR_OK;
 }
@@ -203,6 +562,13 @@ new_conn_callback(
 
 	LWIP_UNUSED_ARG( arg );
 
+	// refuse connection early instead of exhausting PCBs needed by closing connections
+	if( server.connection_count >= CTRL_MAX_CONNECTIONS )
+	{
+		tcp_abort( new_pcb );
+		return ERR_ABRT;
+	}
+
 	connection_t *conn = (connection_t *)mem_malloc( sizeof( *conn ) );
 	if( !conn )
 	{
@@ -210,26 +576,34 @@ new_conn_callback(
 		return ERR_ABRT;
 	}
 
-	char *resp = (char *)mem_malloc( sizeof( INIT_RESPONSE ) - 1 );
-	if( !resp )
+	conn->pcb = new_pcb;
+	conn->rx = NULL;
+	conn->current_page_id = server.initial_page;
+	conn->header = NULL;
+	conn->header_len = 0;
+	conn->snapshot = NULL;
+	conn->unacked = 0;
+	conn->layout = POLL_LAYOUT_V1;
+	conn->stream_port = 0;
+	conn->next_description = ERR_PAGE_ID;
+	conn->flags = 0;
+
+	if( set_page_response( conn, 1 ) != ERR_OK )
 	{
 		mem_free( conn );
 		tcp_abort( new_pcb );
 		return ERR_ABRT;
 	}
 
-	memcpy( resp, INIT_RESPONSE, sizeof( INIT_RESPONSE ) - 1 );
+	conn->id = server.next_connection_id++;
 
-	char buff[ 6 ];
-	snprintf( buff, sizeof( buff ), "%5hu", server.initial_page );
-
-	// TODO find way to get rid of hard-coded 20
-	memcpy( resp + 20, buff, sizeof( buff ) - 1 );
+	// ERR_CONNECTION_ID is never assigned
+	if( server.next_connection_id == ERR_CONNECTION_ID )
+		server.next_connection_id = 0;
 
-	conn->current_page_id = server.initial_page;
-	conn->response = resp;
-	conn->response_len = sizeof( INIT_RESPONSE ) - 1; // -1 for trailing '\0'
-	conn->flags = C_ALLOCATED;
+	conn->next = server.connections;
+	server.connections = conn;
+	++server.connection_count;
 
 	tcp_setprio( new_pcb, TCP_PRIO_MAX );
 
@@ -281,31 +655,152 @@ recv_callback(
 	}
 
 
-	assert( conn->flags & C_IDLE ); // should not receive message before previous has been SENT
-	// maybe should just return ERR_MEM to first deal with previous message
+	if( err != ERR_OK || ( conn->flags & C_BROKEN ) )
+	{
+		pbuf_free( msg_pbuf );
+		return abort_connection( pcb, conn );
+	}
+
+	if( conn->rx )
+		pbuf_cat( conn->rx, msg_pbuf );
+	else
+		conn->rx = msg_pbuf;
+
+	process_input( pcb, conn );
+
+	return ERR_OK;
+}
+
+/**
+ * Processes first received message if connection is not waiting for ACK of previous response.
+ * Client can send more messages without waiting for response,
+ * so message boundaries are found from JSON structure.
+ */
+static void
+process_input(
+		struct tcp_pcb *pcb,
+		connection_t *conn )
+{
+	if( !conn->rx || !( conn->flags & C_IDLE ) )
+		return;
+
+	uint16_t msg_len = message_length( conn->rx );
+
+	if( !msg_len )
+	{
+		// rest of message has not arrived yet
+		if( conn->rx->tot_len < TCP_WND )
+			return;
+
+		// message would never fit into receive window, process it as invalid
+		msg_len = conn->rx->tot_len;
+	}
+
+	const char *msg = (const char *)conn->rx->payload;
+	char *msg_copy = NULL;
+
+	// message is split into more pbufs
+	if( conn->rx->len < msg_len )
+	{
+		msg_copy = (char *)mem_malloc( msg_len );
+		if( !msg_copy )
+			return;
+
+		pbuf_copy_partial( conn->rx, msg_copy, msg_len, 0 );
+		msg = msg_copy;
+	}
+
+	// not enough memory right now, message is processed again from poll callback
+	err_t err = handle_msg( pcb, conn, msg, msg_len );
+
+	if( msg_copy )
+		mem_free( msg_copy );
 
 	if( err != ERR_OK )
+		return;
+
+	conn->rx = pbuf_free_header( conn->rx, msg_len );
+	tcp_recved( pcb, msg_len );
+}
+
+/**
+ * Finds end of first JSON value in received data.
+ * @return Length of first message including leading whitespace, or 0 if message is not complete.
+ * @note Data not starting with JSON object/array are returned whole, so they can be rejected as invalid JSON.
+ */
+static uint16_t
+message_length(
+		const struct pbuf *p )
+{
+	uint16_t depth = 0;
+	uint8_t in_string = 0;
+	uint8_t escaped = 0;
+	uint16_t offset = 0;
+
+	for( const struct pbuf *q = p; q; q = q->next )
 	{
-		// TODO do something smarter
-		free_connection( conn );
-		tcp_abort( pcb );
-		pbuf_free( msg_pbuf );
-		return ERR_ABRT;
+		const char *data = (const char *)q->payload;
+
+		for( uint16_t idx = 0; idx < q->len; ++idx, ++offset )
+		{
+			char c = data[ idx ];
+
+			if( in_string )
+			{
+				if( escaped )
+					escaped = 0;
+				else if( c == '\\' )
+					escaped = 1;
+				else if( c == '"' )
+					in_string = 0;
+			}
+
+			else if( c == '"' )
+				in_string = 1;
+
+			else if( c == '{' || c == '[' )
+				++depth;
+
+			else if( c == '}' || c == ']' )
+			{
+				if( depth && !--depth )
+					return offset + 1;
+			}
+
+			else if( !depth && c != ' ' && c != '\t' && c != '\r' && c != '\n' )
+				return p->tot_len;
+		}
 	}
 
-	server.currently_handled_connection = conn;
+	return 0;
+}
 
-	assert( msg_pbuf->len == msg_pbuf->tot_len ); // TODO accept messages split in more pbufs
+/**
+ * Parses single message and sends response.
+ * @return ERR_OK if response was queued, ERR_MEM if message needs to be processed later.
+ */
+static err_t
+handle_msg(
+		struct tcp_pcb *pcb,
+		connection_t *conn,
+		const char *msg,
+		uint16_t msg_len )
+{
+	server.currently_handled_connection = conn;
 
-	int16_t msg_type = parse_msg( (char *)msg_pbuf->payload, msg_pbuf->len );
+	PROFILE_BEGIN( parse_start );
+	int16_t msg_type = parse_msg( msg, msg_len );
+	PROFILE_END( PROF_PARSE, parse_start );
 
 	// not enough memory to parse right now
 	if( msg_type == JSMN_ERROR_NOMEM )
+	{
+		server.currently_handled_connection = NULL;
 		return ERR_MEM;
+	}
 
-
-	conn->flags &= ~C_IDLE;
-	if( msg_type == JSMN_ERROR_INVAL )
+	// JSMN_ERROR_INVAL or JSMN_ERROR_PART
+	if( msg_type < 0 )
 	{
 		conn->response = ERR_RESPONSE_NOT_JSON;
 		conn->response_len = sizeof( ERR_RESPONSE_NOT_JSON ) - 1; // -1 for trailing '\0'
@@ -321,45 +816,85 @@ recv_callback(
 		page_t *req_page = server.pages[ server.requested_page ];
 		conn->response = req_page->page_description;
 		conn->response_len = req_page->page_desc_len;
+
+		// template is sent with parameters of requested instance in header
+		if( req_page->params )
+		{
+			uint16_t header_size = sizeof( TEMPLATE_HEADER ) + 8 + req_page->params_len;
+			char *header = (char *)mem_malloc( header_size );
+			if( !header )
+			{
+				server.currently_handled_connection = NULL;
+				return ERR_MEM;
+			}
+
+			conn->header = header;
+			conn->header_len = snprintf( header, header_size, TEMPLATE_HEADER, (unsigned long)req_page->template_hash,
+										 (int)req_page->params_len, req_page->params );
+			conn->flags |= C_HEADER_ALLOCATED;
+		}
 	}
 
-	if( msg_type == MSG_CMD_SET )
+	// there is no description to send, connection would never become idle again
+	if( msg_type == MSG_CMD_GET_ALL && !server.page_count )
+	{
+		conn->response = ERR_RESPONSE_NO_PAGES;
+		conn->response_len = sizeof( ERR_RESPONSE_NO_PAGES ) - 1; // -1 for trailing '\0'
+	}
+
+	else if( msg_type == MSG_CMD_GET_ALL )
+	{
+		// descriptions are streamed from sent callback as send buffer frees up
+		server.currently_handled_connection = NULL;
+		conn->next_description = 0;
+		conn->flags &= ~C_IDLE;
+		send_descriptions( pcb, conn );
+		return ERR_OK;
+	}
+
+	if( msg_type == MSG_CMD_SET || msg_type == MSG_CMD_SET_BATCH )
 	{
 		uint16_t page_id = conn->current_page_id;
 		page_t *current_page = server.pages[ page_id ];
 
 		if( !( conn->flags & C_CALLBACK_CALLED ) )
 		{
-			conn->flags |= C_CALLBACK_CALLED;
-
+#if CTRL_DEFERRED_CALLBACKS
+			// values are stored now, callbacks and response follow from mainloop
 			if( current_page->update_callback )
 			{
-				current_page->update_callback( server.widget_id, &server.old_value );
-			}
+				// stored values are marked changed right away, snapshots taken meanwhile carry them
+				if( msg_type == MSG_CMD_SET_BATCH )
+					store_set_batch( current_page );
+				else
+					mark_widget_dirty( current_page, server.widget_id );
 
-			if( server.old_value.val_type == _string )
-				mem_free( server.old_value.value.string_val );
+				work_push( conn, page_id, msg_type == MSG_CMD_SET_BATCH );
+				server.currently_handled_connection = NULL;
+				conn->flags &= ~C_IDLE;
+				return ERR_OK;
+			}
+#endif
+			conn->flags |= C_CALLBACK_CALLED;
+			if( msg_type == MSG_CMD_SET_BATCH )
+				apply_set_batch( current_page );
+			else
+				notify_widget_change( current_page, server.widget_id );
 		}
 
+		// batch is parsed again if response can not be sent now
+		if( msg_type == MSG_CMD_SET_BATCH )
+			free_set_batch();
+
 		if( page_id != conn->current_page_id )
 		{
-			char *resp = (char *)mem_malloc( sizeof( PAGE_RESPONSE ) - 1 );
-
-			if( !resp )
+			if( set_page_response( conn, 0 ) != ERR_OK )
+			{
+				server.currently_handled_connection = NULL;
 				return ERR_MEM;
+			}
 
-			memcpy( resp, PAGE_RESPONSE, sizeof( PAGE_RESPONSE ) - 1 );
-
-			char buff[ 6 ];
-			snprintf( buff, sizeof( buff ), "%5hu", conn->current_page_id );
-
-			// TODO find way to get rid of hard-coded 8
-			memcpy( resp + 8, buff, sizeof( buff ) - 1 );
-
-			conn->response = resp;
-			conn->response_len = sizeof( PAGE_RESPONSE ) - 1; // -1 for trailing '\0'
-			conn->flags |= C_ALLOCATED;
-			conn->flags &= ~C_CALLBACK_CALLED;
+			conn->flags &= ~( C_CALLBACK_CALLED | C_PAGE_PENDING );
 		}
 
 		else
@@ -367,79 +902,149 @@ recv_callback(
 
 	}
 
-	if( msg_type == MSG_CMD_POLL )
+	if( msg_type == MSG_CMD_SERIES )
 	{
-		// send values
-		page_t *page = server.pages[ conn->current_page_id ];
+		page_t *current_page = server.pages[ conn->current_page_id ];
+		const series_t *series = current_page->page_content[ server.widget_id ].value.series_val;
 
-		uint16_t widget_count = page->widget_count;
-		w_val_t *values = page->page_content;
-		uint16_t bin_length = 0;
-		for( uint16_t idx = 0; idx < widget_count; ++idx )
+		if( set_series_response( conn, series, server.widget_id, server.series_since ) != ERR_OK )
 		{
-			switch( values[ idx ].val_type )
-			{
-			case _int:
-				bin_length += sizeof( int32_t ) + 1;
-				break;
-			case _float:
-				bin_length += sizeof( float ) + 1;
-				break;
-			case _string:
-				if( values[ idx ].value.string_val )
-					bin_length += strlen( values[ idx ].value.string_val ) + 2; // trailing '\0' and enable
-				else
-					bin_length += 2;
-			}
+			server.currently_handled_connection = NULL;
+			return ERR_MEM;
 		}
+	}
+
+	if( msg_type == MSG_CMD_STREAM )
+	{
+		stream_start( conn, server.stream_port, server.stream_rate );
+		conn->response = STREAM_RESPONSE;
+		conn->response_len = sizeof( STREAM_RESPONSE ) - 1; // -1 for trailing '\0'
+	}
 
-		char *resp = (char *)mem_malloc( sizeof( POLL_RESPONSE ) + bin_length - 1 );
+	if( msg_type == MSG_CMD_LAYOUT )
+	{
+		conn->layout = server.layout;
+		conn->response = server.layout == POLL_LAYOUT_V2 ? LAYOUT_V2_RESPONSE : LAYOUT_V1_RESPONSE;
+		conn->response_len = sizeof( LAYOUT_V1_RESPONSE ) - 1; // -1 for trailing '\0'
+	}
 
-		if( !resp )
+#if CTRL_PROFILER
+	if( msg_type == MSG_CMD_PROFILE )
+	{
+		if( set_profile_response( conn, server.profile_reset ) != ERR_OK )
+		{
+			server.currently_handled_connection = NULL;
 			return ERR_MEM;
+		}
+	}
+#endif
 
-		uint16_t offset = sizeof( POLL_RESPONSE ) - 1;
-		memcpy( resp, POLL_RESPONSE, offset );
-
-		for( uint16_t idx = 0; idx < widget_count; ++idx )
+	if( msg_type == MSG_CMD_POLL )
+	{
+		if( set_poll_response( conn ) != ERR_OK )
 		{
-			switch( values[ idx ].val_type )
-			{
-			case _int:
-				memcpy( resp + offset, &values[ idx ].value.int_val, sizeof( int32_t ) );
-				offset += sizeof( int32_t );
-				break;
-			case _float:
-				memcpy( resp + offset, &values[ idx ].value.float_val, sizeof( float ) );
-				offset += sizeof( float );
-				break;
-			case _string:
-				if( values[ idx ].value.string_val )
-				{
-					strcpy( resp + offset, values[ idx ].value.string_val );
-					offset += strlen( values[ idx ].value.string_val ) + 1;
-				}
-				else
-					resp[ offset++ ] = '\0';
-			}
-			memcpy( resp + offset, &values[ idx ].enabled, 1 );
-			offset += 1;
+			server.currently_handled_connection = NULL;
+			return ERR_MEM;
 		}
 
-		conn->response = resp;
-		conn->response_len = sizeof( POLL_RESPONSE ) + bin_length - 1; // -1 for trailing '\0'
-		conn->flags |= C_ALLOCATED;
 		conn->flags &= ~C_CALLBACK_CALLED;
 	}
 
+	server.currently_handled_connection = NULL;
+
+	conn->flags &= ~C_IDLE;
 	send_data( pcb, conn );
 
-	tcp_recved( pcb, msg_pbuf->len );
-	pbuf_free( msg_pbuf );
+	return ERR_OK;
+}
+
+/**
+ * Sets values of current page as response, connections displaying same page share one snapshot.
+ * @return ERR_OK on success, ERR_MEM if snapshot could not be allocated.
+ */
+static err_t
+set_poll_response(
+		connection_t *conn )
+{
+	snapshot_t *snapshot = acquire_snapshot( server.pages[ conn->current_page_id ], conn->layout );
+
+	if( !snapshot )
+		return ERR_MEM;
 
+	conn->header = POLL_RESPONSE;
+	conn->header_len = sizeof( POLL_RESPONSE ) - 1; // -1 for trailing '\0'
+	conn->response = snapshot->data;
+	conn->response_len = snapshot->len;
+	conn->snapshot = snapshot;
 	return ERR_OK;
 }
 
+#if CTRL_DEFERRED_CALLBACKS
+/**
+ * Runs callbacks of oldest deferred SET and sends its response,
+ * PAGE if callback changed page of connection, values otherwise.
+ * Single command is processed per mainloop iteration, so lwIP is serviced between slow callbacks.
+ */
+static void process_deferred( void )
+{
+	work_item_t *item = work_peek();
+	if( !item )
+		return;
+
+	connection_t *conn = item->conn;
+
+	if( !item->done )
+	{
+		server.currently_handled_connection = conn;
+		work_run( item );
+		server.currently_handled_connection = NULL;
+	}
+
+	// connection may be freed while callback runs
+	conn = item->conn;
+
+	if( conn )
+	{
+		// response is retried in next iteration, callbacks do not run again
+		if( conn->current_page_id != item->page_id )
+		{
+			if( set_page_response( conn, 0 ) != ERR_OK )
+				return;
+
+			conn->flags &= ~C_PAGE_PENDING;
+		}
+		else if( set_poll_response( conn ) != ERR_OK )
+			return;
+
+		send_data( conn->pcb, conn );
+		tcp_output( conn->pcb );
+	}
+
+	uint8_t was_full = work_full();
+	work_pop();
+
+	// connections waiting for free slot continue without waiting for poll callback
+	if( was_full )
+		for( connection_t *waiting = server.connections; waiting; waiting = waiting->next )
+			if( !( waiting->flags & C_CLOSING ) && ( waiting->flags & C_IDLE ) )
+			{
+				send_pending( waiting->pcb, waiting );
+				tcp_output( waiting->pcb );
+			}
+}
+#endif
+
+#if !CTRL_SETTERS_ONLY
+/**
+ * Values of any page could have been written directly by idle callback.
+ */
+static void values_changed( void )
+{
+	for( uint16_t page_id = 0; page_id < server.page_count; ++page_id )
+		invalidate_snapshot( server.pages[ page_id ] );
+}
+#endif
+
 static void err_callback( void *arg, err_t err )
 {
 #ifdef DEBUG
@@ -460,10 +1065,20 @@ static err_t poll_callback( void *arg, struct tcp_pcb *pcb )
 
 	connection_t *conn = (connection_t *)arg;
 
+	if( conn->flags & C_BROKEN )
+		return abort_connection( pcb, conn );
+
 	// message queue'd to send -> try sending data
 	if( !( conn->flags & ( C_SENT | C_IDLE ) ) )
 		send_data( pcb, conn );
 
+	if( conn->next_description != ERR_PAGE_ID )
+		send_descriptions( pcb, conn );
+
+	// retry messages which could not be processed due to memory shortage
+	if( !( conn->flags & C_CLOSING ) )
+		send_pending( pcb, conn );
+
 
 	// server want's to close && no message to send or message already sent
 	if( ( conn->flags & C_CLOSING ) && ( conn->flags & ( C_SENT | C_IDLE ) ) )
@@ -480,25 +1095,76 @@ static err_t sent_callback( void *arg, struct tcp_pcb *pcb, uint16_t len )
 
 	connection_t *conn = (connection_t *)arg;
 
+	if( conn->flags & C_BROKEN )
+		return abort_connection( pcb, conn );
+
 #ifdef DEBUG
-	assert( conn->response_len = len );
+	assert( conn->unacked >= len );
 	assert( conn->flags & C_SENT );
 	assert( !( conn->flags & C_IDLE ) );
 #endif
 
+	// only part of message was acknowledged
+	conn->unacked -= len;
+
+	// acknowledged data made room for more descriptions of GET ALL
+	if( conn->next_description != ERR_PAGE_ID )
+		send_descriptions( pcb, conn );
+
+	if( conn->unacked || conn->next_description != ERR_PAGE_ID )
+		return ERR_OK;
+
 	if( conn->flags & C_ALLOCATED )
 	{
 		conn->flags &= ~C_ALLOCATED;
 		mem_free( (void *)conn->response );
 	}
 
+	if( conn->flags & C_HEADER_ALLOCATED )
+	{
+		conn->flags &= ~C_HEADER_ALLOCATED;
+		mem_free( (void *)conn->header );
+	}
+
+	if( conn->snapshot )
+	{
+		release_snapshot( conn->snapshot );
+		conn->snapshot = NULL;
+	}
+
+	conn->header = NULL;
+	conn->header_len = 0;
 	conn->response = NULL;
 	conn->flags |= C_IDLE;
 	conn->flags &= ~C_SENT;
 
+	if( !( conn->flags & C_CLOSING ) )
+		send_pending( pcb, conn );
+
 	return ERR_OK;
 }
 
+/**
+ * Sends pushed PAGE message or processes next received message on idle connection.
+ */
+static void send_pending( struct tcp_pcb *pcb, connection_t *conn )
+{
+	if( !( conn->flags & C_IDLE ) )
+		return;
+
+	if( conn->flags & C_PAGE_PENDING )
+	{
+		if( set_page_response( conn, 0 ) != ERR_OK )
+			return;
+
+		conn->flags &= ~( C_IDLE | C_PAGE_PENDING );
+		send_data( pcb, conn );
+		return;
+	}
+
+	process_input( pcb, conn );
+}
+
 static void close_server( struct tcp_pcb *pcb, connection_t *conn )
 {
 	tcp_arg( pcb, NULL );
@@ -521,21 +1187,176 @@ static void close_server( struct tcp_pcb *pcb, connection_t *conn )
 	tcp_poll( pcb, poll_callback, 1 ); // more frequent polling this time ~0.5s
 }
 
+/**
+ * Aborts connection and frees it.
+ * @return ERR_ABRT, which has to be returned from lwIP callback.
+ */
+static err_t abort_connection( struct tcp_pcb *pcb, connection_t *conn )
+{
+	// tcp_abort calls err callback, connection is freed here instead
+	tcp_arg( pcb, NULL );
+	tcp_err( pcb, NULL );
+
+	free_connection( conn );
+	tcp_abort( pcb );
+	return ERR_ABRT;
+}
 
+/**
+ * Computes upper bound of pbufs added to send queue by tcp_write calls queuing len bytes.
+ * Copied data written with TCP_WRITE_FLAG_MORE coalesce into one pbuf per segment,
+ * referenced data take header and data pbuf per segment, both may add one pbuf to last unsent segment.
+ */
+static uint16_t
+queued_pbufs(
+		struct tcp_pcb *pcb,
+		uint16_t len,
+		uint8_t copy )
+{
+	// tcp_write limits segments also by half of largest window announced by client
+	uint16_t mss = (uint16_t)LWIP_MIN( (tcpwnd_size_t)pcb->mss, pcb->snd_wnd_max / 2 );
+	if( !mss )
+		mss = pcb->mss;
+
+	uint16_t segments = ( len + mss - 1 ) / mss;
+	return 1 + ( copy ? segments : 2 * segments );
+}
+
+/**
+ * Queues 4-byte length prefix of message.
+ * @return ERR_OK on success, nothing is queued otherwise.
+ */
+static err_t
+write_prefix(
+		struct tcp_pcb *pcb,
+		uint16_t msg_len )
+{
+	uint8_t temp[4];
+	temp[0] = 0;
+	temp[1] = 0;
+	temp[2] = (uint8_t)( msg_len >> 8 );
+	temp[3] = (uint8_t)( msg_len );
+	return tcp_write( pcb, temp, 4, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE );
+}
+
+
+/**
+ * Queues prefix, header and response as one message.
+ * Writes are checked against send buffer and send queue first, so message is queued whole or not at all.
+ * Response is referenced, unless send queue is too short to ever take it that way, then it is copied.
+ */
 static void send_data( struct tcp_pcb *pcb, connection_t *conn )
 {
-	if( conn->response && conn->response_len + 4 <= tcp_sndbuf( pcb ) )
+	if( conn->flags & C_BROKEN )
+		return;
+
+	uint16_t msg_len = conn->header_len + conn->response_len;
+	uint8_t copy = 0;
+	uint16_t pbufs = queued_pbufs( pcb, 4 + conn->header_len, 1 ) + queued_pbufs( pcb, conn->response_len, 0 );
+
+	if( pbufs >= TCP_SND_QUEUELEN )
+	{
+		copy = TCP_WRITE_FLAG_COPY;
+		pbufs = queued_pbufs( pcb, msg_len + 4, 1 );
+	}
+
+	// tcp_write refuses to write when send queue is full, so one pbuf is kept free
+	if( !conn->response || msg_len + 4 > tcp_sndbuf( pcb ) || tcp_sndqueuelen( pcb ) + pbufs >= TCP_SND_QUEUELEN )
+		return;
+
+	// nothing is queued yet, message is sent again from poll callback
+	if( write_prefix( pcb, msg_len ) != ERR_OK )
+		return;
+
+	err_t err = ERR_OK;
+	if( conn->header_len )
+		err = tcp_write( pcb, conn->header, conn->header_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE );
+
+	if( err == ERR_OK )
+		err = tcp_write( pcb, conn->response, conn->response_len, copy );
+
+	if( err != ERR_OK )
+	{
+		conn->flags |= C_BROKEN | C_CLOSING;
+		return;
+	}
+
+	conn->unacked = msg_len + 4;
+	conn->flags |= C_SENT;
+}
+
+/**
+ * Queues descriptions of pages requested by GET ALL while they fit into send buffer.
+ * Each description is sent as separate message copied into pbufs, so message is queued whole or not at all
+ * and heap holds at most send buffer worth of descriptions.
+ * Connection becomes idle after last description is acknowledged.
+ */
+static void send_descriptions( struct tcp_pcb *pcb, connection_t *conn )
+{
+	if( conn->flags & C_BROKEN )
+		return;
+
+	while( conn->next_description < server.page_count )
 	{
-		uint8_t temp[4];
-		temp[0] = 0;
-		temp[1] = 0;
-		temp[2] = (uint8_t)(conn->response_len >> 8);
-		temp[3] = (uint8_t)(conn->response_len);
-		err_t err = tcp_write( pcb, temp, 4, TCP_WRITE_FLAG_COPY );
-		assert( err == ERR_OK );
+		page_t *page = server.pages[ conn->next_description ];
+
+		char header[ sizeof( DESC_TEMPLATE_HEADER ) + 20 ];
+		uint16_t header_len;
+		uint16_t desc_len = page->page_desc_len;
+
+		if( page->params )
+		{
+			header_len = snprintf( header, sizeof( header ), DESC_TEMPLATE_HEADER, conn->next_description,
+								   server.page_count, (unsigned long)page->desc_hash, (unsigned long)page->template_hash );
+
+			// template is sent only with its first instance, client caches it by hash
+			for( uint16_t page_id = 0; page_id < conn->next_description; ++page_id )
+				if( server.pages[ page_id ]->page_description == page->page_description )
+				{
+					desc_len = 0;
+					break;
+				}
+		}
+		else
+			header_len = snprintf( header, sizeof( header ), DESC_HEADER, conn->next_description,
+								   server.page_count, (unsigned long)page->desc_hash );
+
+		uint16_t msg_len = header_len + page->params_len + ( page->params ? sizeof( DESC_TEMPLATE_END ) - 1 : 0 ) + desc_len;
 
-		err = tcp_write( pcb, conn->response, conn->response_len, 0 );
-		if( err == ERR_OK )
-			conn->flags |= C_SENT;
+		// tcp_write refuses to write when send queue is full, so one pbuf is kept free
+		if( msg_len + 4 > tcp_sndbuf( pcb ) || tcp_sndqueuelen( pcb ) + queued_pbufs( pcb, msg_len + 4, 1 ) >= TCP_SND_QUEUELEN )
+			return;
+
+		// nothing is queued yet, description is sent again from poll or sent callback
+		if( write_prefix( pcb, msg_len ) != ERR_OK )
+			return;
+
+		err_t err = tcp_write( pcb, header, header_len,
+							   TCP_WRITE_FLAG_COPY | ( page->params || desc_len ? TCP_WRITE_FLAG_MORE : 0 ) );
+
+		if( err == ERR_OK && page->params )
+		{
+			err = tcp_write( pcb, page->params, page->params_len, TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE );
+
+			if( err == ERR_OK )
+				err = tcp_write( pcb, DESC_TEMPLATE_END, sizeof( DESC_TEMPLATE_END ) - 1,
+								 TCP_WRITE_FLAG_COPY | ( desc_len ? TCP_WRITE_FLAG_MORE : 0 ) );
+		}
+
+		if( err == ERR_OK && desc_len )
+			err = tcp_write( pcb, page->page_description, desc_len, TCP_WRITE_FLAG_COPY );
+
+		if( err != ERR_OK )
+		{
+			conn->flags |= C_BROKEN | C_CLOSING;
+			return;
+		}
+
+		conn->unacked += msg_len + 4;
+		conn->flags |= C_SENT;
+		++conn->next_description;
 	}
+
+	// everything is queued, rest is handled as any other response
+	conn->next_description = ERR_PAGE_ID;
 }
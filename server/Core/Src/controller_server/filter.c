@@ -0,0 +1,151 @@
+/*
+ * filter.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "filter.h"
+#include "widget_values.h"
+#include "lwip/sys.h"
+#include <string.h>
+#include <math.h>
+
+extern struct ctrl_server server;
+
+
+err_t
+set_page_filters(
+		uint16_t page_id,
+		const widget_filter_t *filters )
+{
+	if( page_id >= server.page_count )
+		return ERR_ARG;
+
+	page_t *page = server.pages[ page_id ];
+	uint16_t held_len = ( page->widget_count + 7 ) / 8;
+
+	// held values and held bitmap are placed right after publication times
+	filter_state_t *state = (filter_state_t *)mem_malloc( sizeof( *state ) +
+														  page->widget_count * sizeof( state->last_publish[ 0 ] ) +
+														  page->widget_count * sizeof( state->held_value[ 0 ] ) +
+														  held_len );
+	if( !state )
+		return ERR_MEM;
+
+	state->held_count = 0;
+	state->held_value = (w_val_t *)( state->last_publish + page->widget_count );
+	state->held = (uint8_t *)( state->held_value + page->widget_count );
+	memset( state->last_publish, 0, page->widget_count * sizeof( state->last_publish[ 0 ] ) );
+	memset( state->held, 0, held_len );
+
+	mem_free( page->filter_state );
+	page->filter_state = state;
+	page->filters = filters;
+	return ERR_OK;
+}
+
+enum filter_result
+filter_value(
+		page_t *page,
+		uint16_t widget_id,
+		float current,
+		float value )
+{
+	if( !page->filters )
+		return FILTER_PASS;
+
+	const widget_filter_t *filter = page->filters + widget_id;
+
+	// deadband is measured from stored value, so slow drift is still published once it adds up
+	float deadband = filter->relative ? filter->deadband * fabsf( current ) : filter->deadband;
+	if( fabsf( value - current ) < deadband )
+	{
+		filter_release( page, widget_id );
+		return FILTER_DROP;
+	}
+
+	if( !filter->min_interval )
+		return FILTER_PASS;
+
+	if( sys_now() - page->filter_state->last_publish[ widget_id ] >= filter->min_interval )
+		return FILTER_PASS;
+
+	return FILTER_HOLD;
+}
+
+void
+filter_hold(
+		page_t *page,
+		uint16_t widget_id,
+		const w_val_t *value )
+{
+	filter_state_t *state = page->filter_state;
+	uint8_t mask = 1 << ( widget_id % 8 );
+
+	state->held_value[ widget_id ] = *value;
+	if( !( state->held[ widget_id / 8 ] & mask ) )
+	{
+		state->held[ widget_id / 8 ] |= mask;
+		++state->held_count;
+	}
+}
+
+void
+filter_release(
+		page_t *page,
+		uint16_t widget_id )
+{
+	filter_state_t *state = page->filter_state;
+	if( !state )
+		return;
+
+	uint8_t mask = 1 << ( widget_id % 8 );
+
+	if( state->held[ widget_id / 8 ] & mask )
+	{
+		state->held[ widget_id / 8 ] &= ~mask;
+		--state->held_count;
+	}
+}
+
+void
+filter_published(
+		page_t *page,
+		uint16_t widget_id )
+{
+	filter_state_t *state = page->filter_state;
+	if( !state )
+		return;
+
+	state->last_publish[ widget_id ] = sys_now();
+	filter_release( page, widget_id );
+}
+
+void filter_process( void )
+{
+	uint32_t now = sys_now();
+
+	for( uint16_t page_id = 0; page_id < server.page_count; ++page_id )
+	{
+		page_t *page = server.pages[ page_id ];
+		filter_state_t *state = page->filter_state;
+
+		if( !state || !state->held_count )
+			continue;
+
+		for( uint16_t widget_id = 0; widget_id < page->widget_count; ++widget_id )
+		{
+			uint8_t mask = 1 << ( widget_id % 8 );
+
+			if( !( state->held[ widget_id / 8 ] & mask ) ||
+				now - state->last_publish[ widget_id ] < page->filters[ widget_id ].min_interval )
+				continue;
+
+			page->page_content[ widget_id ].value = state->held_value[ widget_id ].value;
+
+			// clears held change through filter_published
+			mark_widget_dirty( page, widget_id );
+		}
+	}
+}
@@ -8,6 +8,8 @@
 #include "input_parser.h"
 #include "controller_server.h"
 #include "jsmn_helpers.h"
+#include "widget_values.h"
+#include "work_queue.h"
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
@@ -32,12 +34,27 @@ static const char ERR_RESPONSE_VAL_WRONG_WIDGET_ID[] = "{\"ERR\":\"Expected inte
 static const char ERR_RESPONSE_WIDGET_NOT_ENABLED[] = "{\"ERR\":\"Widget not enabled.\"}";
 static const char ERR_RESPONSE_WRONG_VALUE_TYPE[] = "{\"ERR\":\"Wrong type for value.\"}";
 static const char ERR_RESPONSE_CANT_PARSE_WIDGET_VALUE[] = "{\"ERR\":\"Error parsing widget value.\"}";
+static const char ERR_RESPONSE_STRING_TOO_LONG[] = "{\"ERR\":\"String too long.\"}";
+static const char ERR_RESPONSE_NOT_SERIES[] = "{\"ERR\":\"Widget is not series.\"}";
+static const char ERR_RESPONSE_WRONG_SEQUENCE[] = "{\"ERR\":\"Expected integer as sequence number.\"}";
+static const char ERR_RESPONSE_STREAM_FIELDS[] = "{\"ERR\":\"Expected PORT and RATE integers inside VAL.\"}";
+static const char ERR_RESPONSE_ELEMENT_NOT_PAIR[] = "{\"ERR\":\"Expected [ index, value ] pair as value of array widget.\"}";
+static const char ERR_RESPONSE_INDEX_OUT_OF_RANGE[] = "{\"ERR\":\"Array index out of range.\"}";
+static const char ERR_RESPONSE_UNKNOWN_LAYOUT[] = "{\"ERR\":\"Unsupported layout.\"}";
+static const char ERR_RESPONSE_TOO_LARGE[] = "{\"ERR\":\"Message too large.\"}";
 
 
 
-static uint16_t parse_fields( const char *msg, jsmntok_t *tokens );
+static int16_t parse_fields( const char *msg, jsmntok_t *tokens );
 static uint16_t get_page( const char *msg, jsmntok_t *val_token );
 static uint8_t get_widget_val( const char *msg, jsmntok_t *val_token );
+static int16_t get_widget_batch( const char *msg, jsmntok_t *val_token );
+static uint8_t get_value_type( const char *msg, jsmntok_t *w_val_token, enum value_type *received_type );
+static jsmntok_t *get_array_element( const char *msg, const w_val_t *array_value, jsmntok_t *w_val_token,
+									 uint16_t *index, w_val_t *element );
+static uint8_t get_series_request( const char *msg, jsmntok_t *val_token );
+static uint16_t get_widget_id( const char *msg, jsmntok_t *id_token );
+static uint8_t get_stream_request( const char *msg, jsmntok_t *val_token );
 
 
 
@@ -59,14 +76,22 @@ parse_msg(
 		if( parsed_tokens != JSMN_ERROR_NOMEM )
 			break;
 
+		// message would never fit, waiting for memory would only re-parse it forever
 		if( token_count * 2 > MAX_TOKEN_COUNT )
-			break;
+		{
+			connection_t *conn = server.currently_handled_connection;
+			mem_free( tokens );
+			conn->response = ERR_RESPONSE_TOO_LARGE;
+			conn->response_len = sizeof( ERR_RESPONSE_TOO_LARGE ) - 1;
+			return MSG_INVALID;
+		}
 
 		jsmntok_t *new_t = mem_malloc( sizeof( *tokens ) * token_count * 2 );
 		if( !new_t )
 			break;
 
 		memcpy( new_t, tokens, sizeof( *tokens ) * token_count );
+		mem_free( tokens );
 		tokens = new_t;
 
 		token_count *= 2;
@@ -89,7 +114,7 @@ parse_msg(
 }
 
 
-static uint16_t
+static int16_t
 parse_fields(
 		const char *msg,
 		jsmntok_t *tokens )
@@ -154,6 +179,9 @@ parse_fields(
 		if( page_id == ERR_PAGE_ID )
 			return MSG_INVALID;
 
+		if( page_id == ALL_PAGES_ID )
+			return MSG_CMD_GET_ALL;
+
 		if( page_id >= server.page_count )
 		{
 			conn->response = ERR_RESPONSE_PAGE_OUT_OF_RANGE;
@@ -166,11 +194,66 @@ parse_fields(
 	}
 	else if( cmd_len == 3 && !memcmp( msg + cmd_token->start, "SET", cmd_len ) )
 	{
+#if CTRL_DEFERRED_CALLBACKS
+		// SET stores values while parsing, so it waits in receive buffer until its callbacks can be deferred
+		if( server.pages[ conn->current_page_id ]->update_callback && !( conn->flags & C_CALLBACK_CALLED ) &&
+			work_full() )
+			return JSMN_ERROR_NOMEM;
+#endif
+
+		// [ [ id, value ], ... ] sets several widgets at once
+		if( val_token && val_token->type == JSMN_ARRAY && val_token->size && val_token[ 1 ].type == JSMN_ARRAY )
+			return get_widget_batch( msg, val_token );
+
 		if( !get_widget_val( msg, val_token ) )
 			return MSG_INVALID;
 
 		return MSG_CMD_SET;
 	}
+	else if( cmd_len == 6 && !memcmp( msg + cmd_token->start, "SERIES", cmd_len ) )
+	{
+		if( !get_series_request( msg, val_token ) )
+			return MSG_INVALID;
+
+		return MSG_CMD_SERIES;
+	}
+	else if( cmd_len == 6 && !memcmp( msg + cmd_token->start, "STREAM", cmd_len ) )
+	{
+		if( !get_stream_request( msg, val_token ) )
+			return MSG_INVALID;
+
+		return MSG_CMD_STREAM;
+	}
+	else if( cmd_len == 6 && !memcmp( msg + cmd_token->start, "LAYOUT", cmd_len ) )
+	{
+		char layout = val_token ? msg[ val_token->start ] : '\0';
+		if( !val_token || val_token->type != JSMN_PRIMITIVE || val_token->end - val_token->start != 1 ||
+			layout < '0' + POLL_LAYOUT_V1 || layout > '0' + POLL_LAYOUT_MAX )
+		{
+			conn->response = ERR_RESPONSE_UNKNOWN_LAYOUT;
+			conn->response_len = sizeof( ERR_RESPONSE_UNKNOWN_LAYOUT ) - 1;
+			return MSG_INVALID;
+		}
+
+		server.layout = layout - '0';
+		return MSG_CMD_LAYOUT;
+	}
+#if CTRL_PROFILER
+	else if( cmd_len == 7 && !memcmp( msg + cmd_token->start, "PROFILE", cmd_len ) )
+	{
+		// optional "VAL": "RESET" clears statistics after they are reported
+		server.profile_reset = val_token && val_token->type == JSMN_STRING &&
+							   val_token->end - val_token->start == 5 && !memcmp( msg + val_token->start, "RESET", 5 );
+		if( val_token && !server.profile_reset )
+		{
+			conn->response = ERR_RESPONSE_VAL_NOT_EXPECTED;
+			conn->response_len = sizeof( ERR_RESPONSE_VAL_NOT_EXPECTED ) - 1;
+			return MSG_INVALID;
+		}
+
+		return MSG_CMD_PROFILE;
+	}
+#endif
 	else
 	{
 		conn->response = ERR_RESPONSE_UNKNOWN_CMD;
@@ -204,13 +287,17 @@ static uint16_t get_page( const char *msg, jsmntok_t *val_token )
 		if( key_len == 4 && !memcmp( msg + current->start, "PAGE", key_len ) )
 		{
 			jsmntok_t *page_id_token = current + 1;
+			if( page_id_token->type == JSMN_STRING && page_id_token->end - page_id_token->start == 3 &&
+				!memcmp( msg + page_id_token->start, "ALL", 3 ) )
+				return ALL_PAGES_ID;
+
 			char first = msg[ page_id_token->start ];
 			if( page_id_token->type == JSMN_PRIMITIVE && first >= '0' && first <= '9' )
 			{
 				errno = 0;
 				char *end;
 				long page_id = strtol( msg + page_id_token->start, &end, 10 );
-				if( end > msg + page_id_token->start && page_id < UINT16_MAX && !errno )
+				if( end > msg + page_id_token->start && page_id < ALL_PAGES_ID && !errno )
 					return page_id;
 			}
 			conn->response = ERR_RESPONSE_VAL_INVALID_PAGE_ID;
@@ -252,33 +339,12 @@ static uint8_t get_widget_val( const char *msg, jsmntok_t *val_token )
 
 	jsmntok_t *id_token = val_token + 1;
 
-	char first = msg[ id_token->start ];
-	if( id_token->type != JSMN_PRIMITIVE || first < '0' || first > '9' )
-	{
-		conn->response = ERR_RESPONSE_VAL_WRONG_WIDGET_ID;
-		conn->response_len = sizeof( ERR_RESPONSE_VAL_WRONG_WIDGET_ID ) - 1;
+	uint16_t widget_id = get_widget_id( msg, id_token );
+	if( widget_id == UINT16_MAX )
 		return 0;
-	}
-
-	errno = 0;
-	char *end;
-	long widget_id = strtol( msg + id_token->start, &end, 10 );
-	if( end == msg + id_token->start || widget_id >= UINT16_MAX || errno )
-	{
-		conn->response = ERR_RESPONSE_VAL_WRONG_WIDGET_ID;
-		conn->response_len = sizeof( ERR_RESPONSE_VAL_WRONG_WIDGET_ID ) - 1;
-		return 0;
-	}
 
 	page_t *current_page = server.pages[ conn->current_page_id ];
 
-	if( current_page->widget_count <= widget_id )
-	{
-		conn->response = ERR_RESPONSE_VAL_INVALID_WIDGET_ID;
-		conn->response_len = sizeof( ERR_RESPONSE_VAL_INVALID_WIDGET_ID ) - 1;
-		return 0;
-	}
-
 	w_val_t *current_value = current_page->page_content + widget_id;
 
 	server.widget_id = widget_id;
@@ -293,77 +359,638 @@ static uint8_t get_widget_val( const char *msg, jsmntok_t *val_token )
 
 	jsmntok_t *w_val_token = id_token + 1;
 
+	// element of array is parsed as standalone value and written back to array
+	w_val_t element;
+	w_val_t *target_value = current_value;
+	if( current_value->val_type == _array )
+	{
+		w_val_token = get_array_element( msg, current_value, w_val_token, &server.array_index, &element );
+		if( !w_val_token )
+			return 0;
+
+		target_value = &element;
+		memcpy( &server.old_value, &element, sizeof( server.old_value ) );
+	}
+
 	enum value_type received_type;
+	if( !get_value_type( msg, w_val_token, &received_type ) )
+		return 0;
+
+	const char *error = store_widget_value( target_value, msg + w_val_token->start,
+											w_val_token->end - w_val_token->start, received_type );
+	if( error )
+	{
+		conn->response = error;
+		conn->response_len = strlen( error );
+		return 0;
+	}
+
+	if( target_value == &element )
+		write_array_element( current_value, server.array_index, &element );
+
+	return 1;
+}
+
+/**
+ * Parses [ index, value ] of array widget and reads addressed element.
+ * @return Token of element value, NULL on error( response is set ).
+ */
+static jsmntok_t *
+get_array_element(
+		const char *msg,
+		const w_val_t *array_value,
+		jsmntok_t *w_val_token,
+		uint16_t *index,
+		w_val_t *element )
+{
+	connection_t *conn = server.currently_handled_connection;
+
+	jsmntok_t *index_token = w_val_token + 1;
+	if( w_val_token->type != JSMN_ARRAY || w_val_token->size != 2 || index_token->type != JSMN_PRIMITIVE
+			|| msg[ index_token->start ] < '0' || msg[ index_token->start ] > '9' )
+	{
+		conn->response = ERR_RESPONSE_ELEMENT_NOT_PAIR;
+		conn->response_len = sizeof( ERR_RESPONSE_ELEMENT_NOT_PAIR ) - 1;
+		return NULL;
+	}
+
+	errno = 0;
+	char *end;
+	long received_index = strtol( msg + index_token->start, &end, 10 );
+	if( end == msg + index_token->start || errno || received_index >= array_value->value.array_val->length )
+	{
+		conn->response = ERR_RESPONSE_INDEX_OUT_OF_RANGE;
+		conn->response_len = sizeof( ERR_RESPONSE_INDEX_OUT_OF_RANGE ) - 1;
+		return NULL;
+	}
+
+	*index = received_index;
+	read_array_element( array_value, *index, element );
+	return index_token + 1;
+}
+
+/**
+ * Deduces type of received widget value from JSON token.
+ * @return 1 on success, 0 on error( response is set ).
+ */
+static uint8_t
+get_value_type(
+		const char *msg,
+		jsmntok_t *w_val_token,
+		enum value_type *received_type )
+{
+	connection_t *conn = server.currently_handled_connection;
+
 	if( w_val_token->type == JSMN_STRING )
-		received_type = _string;
-	else if( w_val_token->type == JSMN_PRIMITIVE )
 	{
-		char first = msg[ w_val_token->start ];
-		if( first < '0' || first > '9' )
-		{
-			conn->response = ERR_RESPONSE_WRONG_VALUE_TYPE;
-			conn->response_len = sizeof( ERR_RESPONSE_WRONG_VALUE_TYPE ) - 1;
-			return 0;
-		}
-		received_type = _int;
-		uint16_t msg_len = w_val_token->end - w_val_token->start;
-		if( memchr( msg + w_val_token->start, '.', msg_len ) )
-			received_type = _float;
+		*received_type = _string;
+		return 1;
 	}
-	else
+
+	const char *number = msg + w_val_token->start;
+	if( *number == '-' && w_val_token->end - w_val_token->start > 1 )
+		++number;
+
+	if( w_val_token->type != JSMN_PRIMITIVE || *number < '0' || *number > '9' )
 	{
 		conn->response = ERR_RESPONSE_WRONG_VALUE_TYPE;
 		conn->response_len = sizeof( ERR_RESPONSE_WRONG_VALUE_TYPE ) - 1;
 		return 0;
 	}
 
-	enum value_type target_type = current_value->val_type;
+	*received_type = _int;
+	uint16_t msg_len = w_val_token->end - w_val_token->start;
+	if( memchr( msg + w_val_token->start, '.', msg_len ) )
+		*received_type = _float;
 
-	if( target_type != received_type )
+	return 1;
+}
+
+/**
+ * Parses value of single batch pair without modifying widget.
+ * Numbers and heap strings are parsed into pair->new_value,
+ * strings with capacity only reference text inside message and get buffer for old value.
+ * @return NULL on success, otherwise error response.
+ */
+static const char *
+prepare_set_pair(
+		set_pair_t *pair,
+		const w_val_t *current_value,
+		const char *text,
+		uint16_t len,
+		enum value_type received_type )
+{
+	memcpy( &pair->new_value, current_value, sizeof( pair->new_value ) );
+	pair->old_string = NULL;
+
+	if( current_value->val_type != _string || !current_value->capacity )
+		return store_widget_value( &pair->new_value, text, len, received_type );
+
+	if( received_type != _string )
+		return ERR_RESPONSE_WRONG_VALUE_TYPE;
+
+	if( len > current_value->capacity )
 	{
-		conn->response = ERR_RESPONSE_WRONG_VALUE_TYPE;
-		conn->response_len = sizeof( ERR_RESPONSE_WRONG_VALUE_TYPE ) - 1;
+#if CTRL_STRING_TRUNCATE
+		len = current_value->capacity;
+#else
+		return ERR_RESPONSE_STRING_TOO_LONG;
+#endif
+	}
+
+	pair->old_string = mem_malloc( current_value->capacity + 1 );
+	if( !pair->old_string )
+		return ERR_RESPONSE_CANT_PARSE_WIDGET_VALUE;
+
+	pair->text = text;
+	pair->text_len = len;
+	return NULL;
+}
+
+/**
+ * Parses and validates [ [ widget_id, value ], ... ] of batch SET command.
+ * No widget is modified, prepared pairs are stored in server.batch.
+ * @return MSG_CMD_SET_BATCH on success, MSG_INVALID on error( response is set ),
+ * JSMN_ERROR_NOMEM when batch can not be allocated.
+ */
+static int16_t
+get_widget_batch(
+		const char *msg,
+		jsmntok_t *val_token )
+{
+	connection_t *conn = server.currently_handled_connection;
+	page_t *current_page = server.pages[ conn->current_page_id ];
+
+	server.batch = (set_pair_t *)mem_malloc( val_token->size * sizeof( *server.batch ) );
+	server.batch_len = 0;
+	if( !server.batch )
+		return JSMN_ERROR_NOMEM;
+
+	jsmn_iterator_t it;
+
+	init_iterator( &it, val_token );
+
+	jsmntok_t *pair_token;
+
+	while( ( pair_token = next_value( &it ) ) != NULL )
+	{
+		if( pair_token->type != JSMN_ARRAY || pair_token->size != 2 )
+		{
+			conn->response = ERR_RESPONSE_VAL_WRONG_LEN;
+			conn->response_len = sizeof( ERR_RESPONSE_VAL_WRONG_LEN ) - 1;
+			free_set_batch();
+			return MSG_INVALID;
+		}
+
+		jsmntok_t *id_token = pair_token + 1;
+
+		uint16_t widget_id = get_widget_id( msg, id_token );
+		if( widget_id == UINT16_MAX )
+		{
+			free_set_batch();
+			return MSG_INVALID;
+		}
+
+		const w_val_t *current_value = current_page->page_content + widget_id;
+
+		if( !current_value->enabled )
+		{
+			conn->response = ERR_RESPONSE_WIDGET_NOT_ENABLED;
+			conn->response_len = sizeof( ERR_RESPONSE_WIDGET_NOT_ENABLED ) - 1;
+			free_set_batch();
+			return MSG_INVALID;
+		}
+
+		jsmntok_t *w_val_token = id_token + 1;
+
+		set_pair_t *pair = server.batch + server.batch_len;
+		pair->widget_id = widget_id;
+		pair->index = 0;
+
+		w_val_t element;
+		if( current_value->val_type == _array )
+		{
+			w_val_token = get_array_element( msg, current_value, w_val_token, &pair->index, &element );
+			if( !w_val_token )
+			{
+				free_set_batch();
+				return MSG_INVALID;
+			}
+			current_value = &element;
+		}
+
+		enum value_type received_type;
+		if( !get_value_type( msg, w_val_token, &received_type ) )
+		{
+			free_set_batch();
+			return MSG_INVALID;
+		}
+
+		const char *error = prepare_set_pair( pair, current_value, msg + w_val_token->start,
+											  w_val_token->end - w_val_token->start, received_type );
+		if( error )
+		{
+			conn->response = error;
+			conn->response_len = strlen( error );
+			free_set_batch();
+			return MSG_INVALID;
+		}
+
+		// only fully prepared pairs are released by free_set_batch
+		++server.batch_len;
+	}
+
+	return MSG_CMD_SET_BATCH;
+}
+
+void
+store_set_batch(
+		page_t *page )
+{
+	for( uint16_t idx = 0; idx < server.batch_len; ++idx )
+	{
+		set_pair_t *pair = server.batch + idx;
+		w_val_t *value = page->page_content + pair->widget_id;
+
+		if( value->val_type == _array )
+		{
+			read_array_element( value, pair->index, &pair->old_value );
+			write_array_element( value, pair->index, &pair->new_value );
+			mark_widget_dirty( page, pair->widget_id );
+			continue;
+		}
+
+		memcpy( &pair->old_value, value, sizeof( pair->old_value ) );
+
+		if( pair->old_string )
+		{
+			strcpy( pair->old_string, value->value.string_val );
+			pair->old_value.value.string_val = pair->old_string;
+
+			memcpy( value->value.string_val, pair->text, pair->text_len );
+			value->value.string_val[ pair->text_len ] = '\0';
+		}
+		else
+		{
+			value->value = pair->new_value.value;
+
+			// heap string is owned by widget now
+			if( value->val_type == _string )
+				pair->new_value.value.string_val = NULL;
+		}
+
+		// snapshot taken before callbacks run has to carry stored values under new generation
+		mark_widget_dirty( page, pair->widget_id );
+	}
+}
+
+void
+notify_set_batch(
+		page_t *page,
+		set_pair_t *batch,
+		uint16_t batch_len )
+{
+	for( uint16_t idx = 0; idx < batch_len; ++idx )
+	{
+		set_pair_t *pair = batch + idx;
+
+		memcpy( &server.old_value, &pair->old_value, sizeof( server.old_value ) );
+		server.array_index = pair->index;
+		notify_widget_change( page, pair->widget_id );
+	}
+}
+
+void
+apply_set_batch(
+		page_t *page )
+{
+	// all values are stored before first callback, so every callback sees whole batch applied
+	store_set_batch( page );
+	notify_set_batch( page, server.batch, server.batch_len );
+}
+
+void
+free_batch(
+		set_pair_t *batch,
+		uint16_t batch_len )
+{
+	for( uint16_t idx = 0; idx < batch_len; ++idx )
+	{
+		set_pair_t *pair = batch + idx;
+
+		// heap string of batch which was not applied
+		if( pair->new_value.val_type == _string && !pair->new_value.capacity )
+			mem_free( pair->new_value.value.string_val );
+
+		mem_free( pair->old_string );
+	}
+
+	mem_free( batch );
+}
+
+void free_set_batch( void )
+{
+	free_batch( server.batch, server.batch_len );
+	server.batch = NULL;
+	server.batch_len = 0;
+}
+
+/**
+ * Stores integer into widget of integral type if it fits its range.
+ * @return 1 on success, 0 if value is out of range.
+ */
+static uint8_t
+store_integer(
+		w_val_t *current_value,
+		long long received_value )
+{
+	switch( current_value->val_type )
+	{
+	case _int:
+		if( received_value < INT32_MIN || received_value > INT32_MAX )
+			return 0;
+		current_value->value.int_val = received_value;
+		return 1;
+	case _bool:
+		if( received_value != 0 && received_value != 1 )
+			return 0;
+		current_value->value.bool_val = received_value;
+		return 1;
+	case _u8:
+		if( received_value < 0 || received_value > UINT8_MAX )
+			return 0;
+		current_value->value.u8_val = received_value;
+		return 1;
+	case _i16:
+		if( received_value < INT16_MIN || received_value > INT16_MAX )
+			return 0;
+		current_value->value.i16_val = received_value;
+		return 1;
+	case _u32:
+		if( received_value < 0 || received_value > UINT32_MAX )
+			return 0;
+		current_value->value.u32_val = received_value;
+		return 1;
+	default:
 		return 0;
 	}
+}
+
+const char *
+store_widget_value(
+		w_val_t *current_value,
+		const char *text,
+		uint16_t len,
+		enum value_type received_type )
+{
+	enum value_type target_type = current_value->val_type;
 
+	if( ( target_type == _string || target_type == _series || received_type == _string )
+			&& target_type != received_type )
+		return ERR_RESPONSE_WRONG_VALUE_TYPE;
 
+	char *end;
 	errno = 0;
-	if( target_type == _int )
+	if( target_type == _float )
 	{
-		long received_value = strtol( msg + w_val_token->start, &end, 10 );
-		if( end > msg + w_val_token->start && received_value <= INT32_MAX && received_value >= INT32_MIN && !errno )
+		if( received_type != _float )
+			return ERR_RESPONSE_WRONG_VALUE_TYPE;
+
+		float received_value = strtof( text, &end );
+		if( end > text && !errno && isfinite( received_value ) )
 		{
-			current_value->value.int_val = received_value;
-			return 1;
+			current_value->value.float_val = received_value;
+			return NULL;
 		}
 	}
 
-	else if( target_type == _float )
+	// fixed point accepts both integers and decimals, value is rounded to scale of widget
+	else if( target_type == _fixed )
 	{
-		float received_value = strtof( msg + w_val_token->start, &end );
-		if( end > msg + w_val_token->start &&  !errno && isfinite( received_value ) )
+		double received_value = strtod( text, &end ) * powers_of_ten[ current_value->scale ];
+		if( end > text && !errno && isfinite( received_value )
+				&& received_value <= INT32_MAX && received_value >= INT32_MIN )
 		{
-			current_value->value.float_val = received_value;
-			return 1;
+			current_value->value.fixed_val = ( int32_t )round( received_value );
+			return NULL;
+		}
+	}
+
+#if CTRL_DOUBLE_VALUES
+	else if( target_type == _double )
+	{
+		double received_value = strtod( text, &end );
+		if( end > text && !errno && isfinite( received_value ) )
+		{
+			current_value->value.double_val = received_value;
+			return NULL;
 		}
 	}
+#endif
+
+	else if( target_type != _string )
+	{
+		if( received_type != _int )
+			return ERR_RESPONSE_WRONG_VALUE_TYPE;
+
+		long long received_value = strtoll( text, &end, 10 );
+		if( end > text && !errno && store_integer( current_value, received_value ) )
+			return NULL;
+	}
+
 	else
 	{
-		assert( target_type == _string );
-		uint16_t rec_len = w_val_token->end - w_val_token->start;
+		uint16_t rec_len = len;
+
+		if( current_value->capacity )
+		{
+			if( rec_len > current_value->capacity )
+			{
+#if CTRL_STRING_TRUNCATE
+				rec_len = current_value->capacity;
+#else
+				return ERR_RESPONSE_STRING_TOO_LONG;
+#endif
+			}
+
+			// storage is overwritten, so old value is handed to callback from scratch slot
+			strcpy( server.old_string, current_value->value.string_val );
+			server.old_value.value.string_val = server.old_string;
+
+			memcpy( current_value->value.string_val, text, rec_len );
+			current_value->value.string_val[ rec_len ] = '\0';
+			return NULL;
+		}
+
 		char *new_str = mem_malloc( ( rec_len + 1 ) * sizeof( *new_str ) );
 		if( new_str )
 		{
-			memcpy( new_str, msg + w_val_token->start, rec_len );
+			memcpy( new_str, text, rec_len );
 			new_str[ rec_len ] = '\0';
 			current_value->value.string_val = new_str;
-			return 1;
+			return NULL;
 		}
 	}
 
+	return ERR_RESPONSE_CANT_PARSE_WIDGET_VALUE;
+}
+
+/**
+ * Parses id of widget on current page.
+ * @return Widget id or UINT16_MAX on error( response is set ).
+ */
+static uint16_t get_widget_id( const char *msg, jsmntok_t *id_token )
+{
+	connection_t *conn = server.currently_handled_connection;
+
+	char first = msg[ id_token->start ];
+	if( id_token->type != JSMN_PRIMITIVE || first < '0' || first > '9' )
+	{
+		conn->response = ERR_RESPONSE_VAL_WRONG_WIDGET_ID;
+		conn->response_len = sizeof( ERR_RESPONSE_VAL_WRONG_WIDGET_ID ) - 1;
+		return UINT16_MAX;
+	}
+
+	errno = 0;
+	char *end;
+	long widget_id = strtol( msg + id_token->start, &end, 10 );
+	if( end == msg + id_token->start || widget_id >= UINT16_MAX || errno )
+	{
+		conn->response = ERR_RESPONSE_VAL_WRONG_WIDGET_ID;
+		conn->response_len = sizeof( ERR_RESPONSE_VAL_WRONG_WIDGET_ID ) - 1;
+		return UINT16_MAX;
+	}
 
-	conn->response = ERR_RESPONSE_CANT_PARSE_WIDGET_VALUE;
-	conn->response_len = sizeof( ERR_RESPONSE_CANT_PARSE_WIDGET_VALUE ) - 1;
-	return 0;
+	if( server.pages[ conn->current_page_id ]->widget_count <= widget_id )
+	{
+		conn->response = ERR_RESPONSE_VAL_INVALID_WIDGET_ID;
+		conn->response_len = sizeof( ERR_RESPONSE_VAL_INVALID_WIDGET_ID ) - 1;
+		return UINT16_MAX;
+	}
+
+	return widget_id;
+}
+
+/**
+ * Parses [ widget_id, sequence number ] of SERIES command.
+ * @return 1 on success, 0 on error
+ */
+static uint8_t get_series_request( const char *msg, jsmntok_t *val_token )
+{
+	connection_t *conn = server.currently_handled_connection;
+
+	if( !val_token || val_token->type != JSMN_ARRAY )
+	{
+		conn->response = ERR_RESPONSE_VAL_NOT_ARRAY;
+		conn->response_len = sizeof( ERR_RESPONSE_VAL_NOT_ARRAY ) - 1;
+		return 0;
+	}
+
+	if( val_token->size != 2 )
+	{
+		conn->response = ERR_RESPONSE_VAL_WRONG_LEN;
+		conn->response_len = sizeof( ERR_RESPONSE_VAL_WRONG_LEN ) - 1;
+		return 0;
+	}
+
+	jsmntok_t *id_token = val_token + 1;
+
+	uint16_t widget_id = get_widget_id( msg, id_token );
+	if( widget_id == UINT16_MAX )
+		return 0;
+
+	if( server.pages[ conn->current_page_id ]->page_content[ widget_id ].val_type != _series )
+	{
+		conn->response = ERR_RESPONSE_NOT_SERIES;
+		conn->response_len = sizeof( ERR_RESPONSE_NOT_SERIES ) - 1;
+		return 0;
+	}
+
+	jsmntok_t *seq_token = id_token + 1;
+
+	char first = msg[ seq_token->start ];
+	if( seq_token->type != JSMN_PRIMITIVE || first < '0' || first > '9' )
+	{
+		conn->response = ERR_RESPONSE_WRONG_SEQUENCE;
+		conn->response_len = sizeof( ERR_RESPONSE_WRONG_SEQUENCE ) - 1;
+		return 0;
+	}
+
+	errno = 0;
+	char *end;
+	unsigned long long since = strtoull( msg + seq_token->start, &end, 10 );
+	if( end == msg + seq_token->start || since > UINT32_MAX || errno )
+	{
+		conn->response = ERR_RESPONSE_WRONG_SEQUENCE;
+		conn->response_len = sizeof( ERR_RESPONSE_WRONG_SEQUENCE ) - 1;
+		return 0;
+	}
+
+	server.widget_id = widget_id;
+	server.series_since = since;
+	return 1;
 }
 
+/**
+ * Parses { "PORT": port, "RATE": rate } of STREAM command.
+ * @return 1 on success, 0 on error
+ */
+static uint8_t get_stream_request( const char *msg, jsmntok_t *val_token )
+{
+	connection_t *conn = server.currently_handled_connection;
+
+	if( !val_token || val_token->type != JSMN_OBJECT )
+	{
+		conn->response = ERR_RESPONSE_VAL_NOT_OBJECT;
+		conn->response_len = sizeof( ERR_RESPONSE_VAL_NOT_OBJECT ) - 1;
+		return 0;
+	}
+
+	long port = -1;
+	long rate = -1;
+
+	jsmn_iterator_t it;
+
+	init_iterator( &it, val_token );
+
+	jsmntok_t *current;
+
+	while( ( current = next_value( &it ) ) != NULL )
+	{
+		uint16_t key_len = current->end - current->start;
+		jsmntok_t *value_token = current + 1;
+		long *target;
+
+		if( key_len == 4 && !memcmp( msg + current->start, "PORT", key_len ) )
+			target = &port;
+		else if( key_len == 4 && !memcmp( msg + current->start, "RATE", key_len ) )
+			target = &rate;
+		else
+		{
+			conn->response = ERR_RESPONSE_STREAM_FIELDS;
+			conn->response_len = sizeof( ERR_RESPONSE_STREAM_FIELDS ) - 1;
+			return 0;
+		}
+
+		char first = msg[ value_token->start ];
+		if( value_token->type != JSMN_PRIMITIVE || first < '0' || first > '9' )
+			break;
+
+		errno = 0;
+		char *end;
+		*target = strtol( msg + value_token->start, &end, 10 );
+		if( end == msg + value_token->start || *target > UINT16_MAX || errno )
+			*target = -1;
+	}
+
+	if( port <= 0 || rate < 0 )
+	{
+		conn->response = ERR_RESPONSE_STREAM_FIELDS;
+		conn->response_len = sizeof( ERR_RESPONSE_STREAM_FIELDS ) - 1;
+		return 0;
+	}
+
+	server.stream_port = port;
+	server.stream_rate = rate;
+	return 1;
+}
@@ -0,0 +1,467 @@
+/*
+ * mqtt_bridge.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "mqtt_bridge.h"
+
+#if CTRL_MQTT_BRIDGE
+
+#include "input_parser.h"
+#include "widget_values.h"
+#include "work_queue.h"
+#include "lwip/apps/mqtt.h"
+#include "lwip/sys.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+extern struct ctrl_server server;
+
+/**
+ * <prefix>/<page_id>/<widget_id>/set
+ */
+#define TOPIC_SIZE ( sizeof( CTRL_MQTT_TOPIC_PREFIX ) + 18 )
+
+// published instead of value which does not fit into CTRL_MQTT_PAYLOAD_SIZE
+static const char PAYLOAD_TOO_LARGE[] = "{\"ERR\":\"Value too large.\"}";
+
+static struct
+{
+	mqtt_client_t *client;
+	ip_addr_t broker;
+	uint16_t port;
+	struct mqtt_connect_client_info_t info;
+
+	/**
+	 * Time of last publishing and last connection attempt( sys_now ).
+	 */
+	uint32_t last_publish;
+	uint32_t last_connect;
+
+	/**
+	 * Widget targeted by incoming publish, ERR_PAGE_ID if topic is not valid.
+	 */
+	uint16_t page_id;
+	uint16_t widget_id;
+
+	/**
+	 * Payload of incoming publish.
+	 */
+	char payload[ CTRL_MAX_STRING_CAPACITY + 1 ];
+	uint16_t payload_len;
+} bridge;
+
+static void connection_callback( mqtt_client_t *client, void *arg, mqtt_connection_status_t status );
+static void incoming_publish_callback( void *arg, const char *topic, uint32_t tot_len );
+static void incoming_data_callback( void *arg, const uint8_t *data, uint16_t len, uint8_t flags );
+static void apply_payload( void );
+static void publish_changes( void );
+static uint16_t format_value( char *buff, uint16_t size, const w_val_t *value, uint8_t json );
+static void mark_all_unpublished( void );
+
+
+err_t
+mqtt_bridge_start(
+		const ip_addr_t *broker,
+		uint16_t port,
+		const char *client_id )
+{
+#ifdef DEBUG
+	assert( sizeof( PAYLOAD_TOO_LARGE ) <= CTRL_MQTT_PAYLOAD_SIZE );
+#endif
+
+	bridge.client = mqtt_client_new();
+	if( !bridge.client )
+		return ERR_MEM;
+
+	ip_addr_copy( bridge.broker, *broker );
+	bridge.port = port;
+
+	memset( &bridge.info, 0, sizeof( bridge.info ) );
+	bridge.info.client_id = client_id;
+	bridge.info.keep_alive = 60;
+
+	// first attempt is made right away
+	bridge.last_connect = sys_now() - CTRL_MQTT_RECONNECT_PERIOD;
+	bridge.last_publish = sys_now();
+	bridge.page_id = ERR_PAGE_ID;
+
+	mqtt_set_inpub_callback( bridge.client, incoming_publish_callback, incoming_data_callback, NULL );
+
+	return ERR_OK;
+}
+
+void mqtt_bridge_process( void )
+{
+	if( !bridge.client )
+		return;
+
+	uint32_t now = sys_now();
+
+	if( !mqtt_client_is_connected( bridge.client ) )
+	{
+		if( now - bridge.last_connect < CTRL_MQTT_RECONNECT_PERIOD )
+			return;
+
+		bridge.last_connect = now;
+
+		// ERR_ISCONN while previous attempt is still in progress
+		mqtt_client_connect( bridge.client, &bridge.broker, bridge.port, connection_callback, NULL, &bridge.info );
+		return;
+	}
+
+	if( now - bridge.last_publish < CTRL_MQTT_PUBLISH_PERIOD )
+		return;
+
+	bridge.last_publish = now;
+	publish_changes();
+}
+
+static void
+connection_callback(
+		mqtt_client_t *client,
+		void *arg,
+		mqtt_connection_status_t status )
+{
+	LWIP_UNUSED_ARG( arg );
+
+	if( status != MQTT_CONNECT_ACCEPTED )
+		return;
+
+	// broker may have lost retained values, everything is published again
+	mark_all_unpublished();
+
+	mqtt_subscribe( client, CTRL_MQTT_TOPIC_PREFIX "/+/+/set", 0, NULL, NULL );
+}
+
+/**
+ * Parses <prefix>/<page_id>/<widget_id>/set topic.
+ */
+static void
+incoming_publish_callback(
+		void *arg,
+		const char *topic,
+		uint32_t tot_len )
+{
+	LWIP_UNUSED_ARG( arg );
+
+	bridge.page_id = ERR_PAGE_ID;
+	bridge.payload_len = 0;
+
+	if( tot_len > CTRL_MAX_STRING_CAPACITY )
+		return;
+
+	if( strncmp( topic, CTRL_MQTT_TOPIC_PREFIX "/", sizeof( CTRL_MQTT_TOPIC_PREFIX ) ) )
+		return;
+
+	const char *ids = topic + sizeof( CTRL_MQTT_TOPIC_PREFIX );
+	char *end;
+
+	unsigned long page_id = strtoul( ids, &end, 10 );
+	if( end == ids || *end != '/' || page_id >= server.page_count )
+		return;
+
+	ids = end + 1;
+	unsigned long widget_id = strtoul( ids, &end, 10 );
+	if( end == ids || strcmp( end, "/set" ) || widget_id >= server.pages[ page_id ]->widget_count )
+		return;
+
+	bridge.page_id = page_id;
+	bridge.widget_id = widget_id;
+}
+
+static void
+incoming_data_callback(
+		void *arg,
+		const uint8_t *data,
+		uint16_t len,
+		uint8_t flags )
+{
+	LWIP_UNUSED_ARG( arg );
+
+	if( bridge.page_id == ERR_PAGE_ID )
+		return;
+
+	// length was checked against tot_len in publish callback
+	memcpy( bridge.payload + bridge.payload_len, data, len );
+	bridge.payload_len += len;
+
+	if( !( flags & MQTT_DATA_FLAG_LAST ) )
+		return;
+
+	bridge.payload[ bridge.payload_len ] = '\0';
+	apply_payload();
+	bridge.page_id = ERR_PAGE_ID;
+}
+
+/**
+ * Applies received payload same way as SET command.
+ * Invalid values are silently dropped, since there is nobody to respond to.
+ */
+static void apply_payload( void )
+{
+	page_t *page = server.pages[ bridge.page_id ];
+	w_val_t *value = page->page_content + bridge.widget_id;
+
+	// arrays are published, but elements can't be addressed by topic
+	if( !value->enabled || value->val_type == _series || value->val_type == _array )
+		return;
+
+	// payload is not JSON, so type is deduced from widget, numbers with '.' are decimals
+	enum value_type received_type = value->val_type;
+	if( received_type != _string && received_type != _float )
+		received_type = memchr( bridge.payload, '.', bridge.payload_len ) ? _float : _int;
+
+	memcpy( &server.old_value, value, sizeof( server.old_value ) );
+
+	if( store_widget_value( value, bridge.payload, bridge.payload_len, received_type ) )
+		return;
+
+	server.widget_id = bridge.widget_id;
+
+#if CTRL_DEFERRED_CALLBACKS
+	// callback runs from mainloop as callback of SET command, there is no connection to respond to
+	// publish can not wait in receive buffer, so callback runs right away when queue is full
+	if( page->update_callback && !work_full() )
+	{
+		work_push( NULL, bridge.page_id, 0 );
+		return;
+	}
+#endif
+
+	// callbacks see no connection, so change_page has no effect
+	server.currently_handled_connection = NULL;
+	notify_widget_change( page, bridge.widget_id );
+}
+
+static void publish_changes( void )
+{
+	char topic[ TOPIC_SIZE ];
+	char payload[ CTRL_MQTT_PAYLOAD_SIZE ];
+
+	for( uint16_t page_id = 0; page_id < server.page_count; ++page_id )
+	{
+		page_t *page = server.pages[ page_id ];
+
+#if CTRL_MQTT_PER_PAGE
+		uint8_t changed = 0;
+		for( uint16_t idx = 0; idx < ( page->widget_count + 7 ) / 8; ++idx )
+			changed |= page->mqtt_dirty[ idx ];
+
+		if( !changed )
+			continue;
+
+		uint16_t len;
+		uint32_t sequence;
+
+		// formatted again if interrupt producer wrote values meanwhile
+		do
+		{
+			sequence = read_begin( page );
+			len = 0;
+			payload[ len++ ] = '[';
+			for( uint16_t widget_id = 0; widget_id < page->widget_count && len < sizeof( payload ); ++widget_id )
+			{
+				if( widget_id )
+					payload[ len++ ] = ',';
+				len += format_value( payload + len, sizeof( payload ) - len, page->page_content + widget_id, 1 );
+			}
+		}
+		while( read_retry( page, sequence ) );
+
+		// page does not fit into payload, marker is published instead, so page is not formatted again until it changes
+		if( len >= sizeof( payload ) - 1 )
+		{
+			len = sizeof( PAYLOAD_TOO_LARGE ) - 1;
+			memcpy( payload, PAYLOAD_TOO_LARGE, len );
+		}
+		else
+			payload[ len++ ] = ']';
+
+		snprintf( topic, sizeof( topic ), CTRL_MQTT_TOPIC_PREFIX "/%hu", page_id );
+
+		// output buffer is full, page is published in next period
+		if( mqtt_publish( bridge.client, topic, payload, len, 0, 1, NULL, NULL ) != ERR_OK )
+			return;
+
+		memset( page->mqtt_dirty, 0, ( page->widget_count + 7 ) / 8 );
+#else
+		for( uint16_t widget_id = 0; widget_id < page->widget_count; ++widget_id )
+		{
+			if( !( page->mqtt_dirty[ widget_id / 8 ] & ( 1 << ( widget_id % 8 ) ) ) )
+				continue;
+
+			const w_val_t *value = page->page_content + widget_id;
+
+			if( value->val_type != _series )
+			{
+				uint16_t len;
+				uint32_t sequence;
+
+				// formatted again if interrupt producer wrote value meanwhile
+				do
+				{
+					sequence = read_begin( page );
+					len = format_value( payload, sizeof( payload ), value, 0 );
+				}
+				while( read_retry( page, sequence ) );
+
+				if( len >= sizeof( payload ) )
+				{
+					len = sizeof( PAYLOAD_TOO_LARGE ) - 1;
+					memcpy( payload, PAYLOAD_TOO_LARGE, len );
+				}
+
+				snprintf( topic, sizeof( topic ), CTRL_MQTT_TOPIC_PREFIX "/%hu/%hu", page_id, widget_id );
+
+				// output buffer is full, rest of values is published in next period
+				if( mqtt_publish( bridge.client, topic, payload, len, 0, 1, NULL, NULL ) != ERR_OK )
+					return;
+			}
+
+			page->mqtt_dirty[ widget_id / 8 ] &= ~( 1 << ( widget_id % 8 ) );
+		}
+#endif
+	}
+}
+
+/**
+ * Formats value as text, strings are quoted and escaped when json is set.
+ * @return Length of text( without trailing '\0' ), size if text does not fit.
+ */
+static uint16_t
+format_value(
+		char *buff,
+		uint16_t size,
+		const w_val_t *value,
+		uint8_t json )
+{
+	int len = 0;
+
+	switch( value->val_type )
+	{
+	case _int:
+		len = snprintf( buff, size, "%ld", (long)value->value.int_val );
+		break;
+
+	case _bool:
+	case _u8:
+		len = snprintf( buff, size, "%u", (unsigned)value->value.u8_val );
+		break;
+
+	case _i16:
+		len = snprintf( buff, size, "%d", (int)value->value.i16_val );
+		break;
+
+	case _u32:
+		len = snprintf( buff, size, "%lu", (unsigned long)value->value.u32_val );
+		break;
+
+	case _fixed:
+	{
+		int32_t fixed = value->value.fixed_val;
+		uint32_t magnitude = fixed < 0 ? -(uint32_t)fixed : (uint32_t)fixed;
+		uint32_t divisor = powers_of_ten[ value->scale ];
+
+		if( !value->scale )
+			len = snprintf( buff, size, "%ld", (long)fixed );
+		else
+			len = snprintf( buff, size, "%s%lu.%0*lu", fixed < 0 ? "-" : "", (unsigned long)( magnitude / divisor ),
+							(int)value->scale, (unsigned long)( magnitude % divisor ) );
+		break;
+	}
+
+	case _float:
+#if CTRL_DOUBLE_VALUES
+	case _double:
+#endif
+	{
+		float number = value->value.float_val;
+#if CTRL_DOUBLE_VALUES
+		if( value->val_type == _double )
+			number = value->value.double_val;
+#endif
+
+		// printf of floats is not linked with newlib-nano, value is printed with 3 decimals
+		float abs_val = fabsf( number );
+		if( abs_val > 4e9f )
+			abs_val = 4e9f;
+
+		uint32_t whole = (uint32_t)abs_val;
+		uint32_t fraction = (uint32_t)( ( abs_val - whole ) * 1000.0f + 0.5f );
+		if( fraction == 1000 )
+		{
+			++whole;
+			fraction = 0;
+		}
+
+		len = snprintf( buff, size, "%s%lu.%03lu", number < 0 ? "-" : "",
+						(unsigned long)whole, (unsigned long)fraction );
+		break;
+	}
+
+	case _string:
+	{
+		const char *str = value->value.string_val ? value->value.string_val : "";
+
+		if( !json )
+		{
+			len = snprintf( buff, size, "%s", str );
+			break;
+		}
+
+		if( size )
+			buff[ len++ ] = '"';
+		for( ; *str && len + 3 < size; ++str )
+		{
+			if( *str == '"' || *str == '\\' )
+				buff[ len++ ] = '\\';
+			buff[ len++ ] = *str;
+		}
+		if( *str || len + 1 >= size )
+			return size;
+		buff[ len++ ] = '"';
+		break;
+	}
+
+	case _series:
+		len = snprintf( buff, size, "%lu", (unsigned long)value->value.series_val->seq );
+		break;
+
+	case _array:
+	{
+		// published as JSON array in both modes
+		w_val_t element;
+		if( size )
+			buff[ len++ ] = '[';
+		for( uint16_t idx = 0; idx < value->value.array_val->length && len < size; ++idx )
+		{
+			if( idx )
+				buff[ len++ ] = ',';
+			read_array_element( value, idx, &element );
+			len += format_value( buff + len, size - len, &element, json );
+		}
+		if( len + 1 >= size )
+			return size;
+		buff[ len++ ] = ']';
+		break;
+	}
+	}
+
+	return len < 0 || len >= size ? size : len;
+}
+
+static void mark_all_unpublished( void )
+{
+	for( uint16_t page_id = 0; page_id < server.page_count; ++page_id )
+	{
+		page_t *page = server.pages[ page_id ];
+		memset( page->mqtt_dirty, 0xFF, ( page->widget_count + 7 ) / 8 );
+	}
+}
+
+#endif /* CTRL_MQTT_BRIDGE */
@@ -0,0 +1,186 @@
+/*
+ * profiler.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "profiler.h"
+
+#if CTRL_PROFILER
+
+#include <string.h>
+#include <stdio.h>
+
+/**
+ * Size of trace entry in response( uint32 start, uint32 cycles, uint8 stage ).
+ */
+#define TRACE_ENTRY_SIZE 9
+
+typedef struct profile_stats
+{
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t total;
+} profile_stats_t;
+
+typedef struct profile_entry
+{
+	uint32_t start;
+	uint32_t cycles;
+	uint8_t stage;
+} profile_entry_t;
+
+static struct
+{
+	profile_stats_t stats[ PROF_STAGE_COUNT ];
+	profile_entry_t trace[ CTRL_PROFILE_TRACE_LENGTH ];
+	uint16_t trace_head;
+	uint16_t trace_count;
+} profile;
+
+// names are indexed by stage, trace entries refer to them by index
+static const char *const STAGE_NAMES[ PROF_STAGE_COUNT ] =
+{
+	"loop", "lwip_process", "ethernetif_input", "parse_msg", "serialize", "callback", "services"
+};
+
+static const char PROFILE_HEADER[] = "{\"PROFILE\":\"BIN\",\"CLK\":%lu,\"UTIL\":%lu,\"STAGES\":[";
+static const char PROFILE_STAGE[] = "%s{\"NAME\":\"%s\",\"N\":%lu,\"MIN\":%lu,\"AVG\":%lu,\"MAX\":%lu}";
+static const char PROFILE_END_TEXT[] = "],\"TRACE\":%hu}";
+
+// longest stage name and five 32-bit numbers
+#define STAGE_TEXT_SIZE ( sizeof( PROFILE_STAGE ) + 16 + 5 * 10 )
+
+static void profile_reset( void );
+
+
+void profile_init( void )
+{
+#ifdef __arm__
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->LAR = 0xC5ACCE55; // Cortex-M7 requires unlocking DWT
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	profile_reset();
+}
+
+void
+profile_record(
+		uint8_t stage,
+		uint32_t start )
+{
+	// modular arithmetic keeps working after counter wraps around
+	uint32_t cycles = profile_now() - start;
+	profile_stats_t *stats = profile.stats + stage;
+
+	++stats->count;
+	stats->total += cycles;
+	if( cycles < stats->min )
+		stats->min = cycles;
+	if( cycles > stats->max )
+		stats->max = cycles;
+
+	if( cycles < CTRL_PROFILE_TRACE_THRESHOLD )
+		return;
+
+	profile_entry_t *entry = profile.trace + ( profile.trace_head + profile.trace_count ) % CTRL_PROFILE_TRACE_LENGTH;
+	entry->start = start;
+	entry->cycles = cycles;
+	entry->stage = stage;
+
+	// oldest entry is overwritten
+	if( profile.trace_count < CTRL_PROFILE_TRACE_LENGTH )
+		++profile.trace_count;
+	else
+		profile.trace_head = ( profile.trace_head + 1 ) % CTRL_PROFILE_TRACE_LENGTH;
+}
+
+err_t
+set_profile_response(
+		connection_t *conn,
+		uint8_t reset )
+{
+	// more entries than send buffer can take are never sent
+	uint16_t max_trace = tcp_sndbuf( conn->pcb ) / TRACE_ENTRY_SIZE;
+	if( max_trace > profile.trace_count )
+		max_trace = profile.trace_count;
+
+	uint16_t size = sizeof( PROFILE_HEADER ) + 30 + PROF_STAGE_COUNT * STAGE_TEXT_SIZE +
+					sizeof( PROFILE_END_TEXT ) + 5 + max_trace * TRACE_ENTRY_SIZE;
+
+	char *resp = (char *)mem_malloc( size );
+	if( !resp )
+		return ERR_MEM;
+
+#ifdef __arm__
+	uint32_t clock = SystemCoreClock;
+#else
+	uint32_t clock = 1000000000;
+#endif
+
+	// utilisation is share of mainloop spent in lwIP and server processing( per mille ), idle callback excluded
+	uint64_t busy = profile.stats[ PROF_LWIP_PROCESS ].total + profile.stats[ PROF_SERVICES ].total;
+	uint64_t loop = profile.stats[ PROF_LOOP ].total;
+	uint32_t utilisation = loop ? (uint32_t)( busy * 1000 / loop ) : 0;
+
+	uint16_t len = snprintf( resp, size, PROFILE_HEADER, (unsigned long)clock, (unsigned long)utilisation );
+
+	for( uint8_t stage = 0; stage < PROF_STAGE_COUNT; ++stage )
+	{
+		const profile_stats_t *stats = profile.stats + stage;
+		uint32_t average = stats->count ? (uint32_t)( stats->total / stats->count ) : 0;
+
+		len += snprintf( resp + len, size - len, PROFILE_STAGE, stage ? "," : "", STAGE_NAMES[ stage ],
+						 (unsigned long)stats->count, (unsigned long)( stats->count ? stats->min : 0 ),
+						 (unsigned long)average, (unsigned long)stats->max );
+	}
+
+	// response is queued only if it fits into send buffer as whole, so only newest entries are sent
+	uint16_t room = tcp_sndbuf( conn->pcb );
+	uint16_t used = 4 + len + sizeof( PROFILE_END_TEXT ) + 5; // length prefix and up to 5 digits of count
+	if( room < used )
+	{
+		mem_free( resp );
+		return ERR_MEM;
+	}
+
+	uint16_t trace_count = ( room - used ) / TRACE_ENTRY_SIZE;
+	if( trace_count > max_trace )
+		trace_count = max_trace;
+
+	len += snprintf( resp + len, size - len, PROFILE_END_TEXT, trace_count );
+
+	// trace follows JSON, little endian as all binary data
+	for( uint16_t idx = profile.trace_count - trace_count; idx < profile.trace_count; ++idx )
+	{
+		const profile_entry_t *entry = profile.trace + ( profile.trace_head + idx ) % CTRL_PROFILE_TRACE_LENGTH;
+		memcpy( resp + len, &entry->start, sizeof( entry->start ) );
+		memcpy( resp + len + 4, &entry->cycles, sizeof( entry->cycles ) );
+		resp[ len + 8 ] = entry->stage;
+		len += TRACE_ENTRY_SIZE;
+	}
+
+	if( reset )
+		profile_reset();
+
+	conn->header = NULL;
+	conn->header_len = 0;
+	conn->response = resp;
+	conn->response_len = len;
+	conn->flags |= C_ALLOCATED;
+
+	return ERR_OK;
+}
+
+static void profile_reset( void )
+{
+	memset( &profile, 0, sizeof( profile ) );
+	for( uint8_t stage = 0; stage < PROF_STAGE_COUNT; ++stage )
+		profile.stats[ stage ].min = UINT32_MAX;
+}
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * series.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "series.h"
+#include "widget_values.h"
+#include "lwip/sys.h"
+#include <string.h>
+
+extern struct ctrl_server server;
+
+static char SERIES_RESPONSE[] = "{\"SERIES\":\"BIN\"}"; // followed by raw binary data
+
+#define SERIES_BATCH_HEADER_LEN ( sizeof( uint16_t ) + sizeof( uint32_t ) + sizeof( uint16_t ) )
+
+#if CTRL_MAX_SERIES_BATCH * 8 + SERIES_RESPONSE_OVERHEAD > TCP_SND_BUF
+#error "SERIES response of CTRL_MAX_SERIES_BATCH samples does not fit into TCP_SND_BUF"
+#endif
+
+err_t
+series_push(
+		uint16_t page_id,
+		uint16_t widget_id,
+		float value )
+{
+	w_val_t *current = find_value( page_id, widget_id, _series );
+	if( !current )
+		return ERR_ARG;
+
+	series_t *series = current->value.series_val;
+
+	series->samples[ series->head ].timestamp = sys_now();
+	series->samples[ series->head ].value = value;
+
+	if( ++series->head == series->capacity )
+		series->head = 0;
+	++series->seq;
+
+	// POLL carries sequence number of series, widget is marked changed later by sync_series
+	server.pages[ page_id ]->series_pending = 1;
+	return ERR_OK;
+}
+
+void
+sync_series(
+		page_t *page )
+{
+	uint32_t now = sys_now();
+	if( !page->series_pending || now - page->series_time < CTRL_SERIES_NOTIFY_PERIOD )
+		return;
+
+	page->series_pending = 0;
+	page->series_time = now;
+
+	for( uint16_t widget_id = 0; widget_id < page->widget_count; ++widget_id )
+	{
+		w_val_t *value = page->page_content + widget_id;
+		if( value->val_type != _series )
+			continue;
+
+		series_t *series = value->value.series_val;
+		if( series->announced_seq == series->seq )
+			continue;
+
+		series->announced_seq = series->seq;
+		mark_widget_dirty( page, widget_id );
+	}
+}
+
+err_t
+set_series_response(
+		connection_t *conn,
+		const series_t *series,
+		uint16_t widget_id,
+		uint32_t since )
+{
+	uint32_t available = series->seq < series->capacity ? series->seq : series->capacity;
+
+	// modular arithmetic keeps working after sequence number wraps around
+	uint32_t behind = series->seq - since;
+
+	// client lost samples which were overwritten, or asks for future ones
+	if( behind > available )
+	{
+		behind = available;
+		since = series->seq - available;
+	}
+
+#ifdef DEBUG
+	assert( SERIES_RESPONSE_OVERHEAD == 4 + sizeof( SERIES_RESPONSE ) - 1 + SERIES_BATCH_HEADER_LEN );
+#endif
+
+	// response is queued only if it fits into send buffer as whole
+	uint16_t room = tcp_sndbuf( conn->pcb );
+	if( room < SERIES_RESPONSE_OVERHEAD )
+		return ERR_MEM;
+
+	uint16_t fits = ( room - SERIES_RESPONSE_OVERHEAD ) / sizeof( series_sample_t );
+	uint16_t count = behind > CTRL_MAX_SERIES_BATCH ? CTRL_MAX_SERIES_BATCH : behind;
+	if( count > fits )
+		count = fits;
+
+	uint16_t len = SERIES_BATCH_HEADER_LEN + count * sizeof( series_sample_t );
+	char *resp = (char *)mem_malloc( len );
+	if( !resp )
+		return ERR_MEM;
+
+	memcpy( resp, &widget_id, sizeof( widget_id ) );
+	memcpy( resp + 2, &since, sizeof( since ) );
+	memcpy( resp + 6, &count, sizeof( count ) );
+
+	// samples are copied, ring buffer can be overwritten before ACK
+	uint16_t start = ( series->head + series->capacity - behind ) % series->capacity;
+	uint16_t first_part = series->capacity - start < count ? series->capacity - start : count;
+
+	memcpy( resp + SERIES_BATCH_HEADER_LEN, series->samples + start, first_part * sizeof( series_sample_t ) );
+	memcpy( resp + SERIES_BATCH_HEADER_LEN + first_part * sizeof( series_sample_t ),
+			series->samples, ( count - first_part ) * sizeof( series_sample_t ) );
+
+	conn->header = SERIES_RESPONSE;
+	conn->header_len = sizeof( SERIES_RESPONSE ) - 1; // -1 for trailing '\0'
+	conn->response = resp;
+	conn->response_len = len;
+	conn->flags |= C_ALLOCATED;
+
+	return ERR_OK;
+}
@@ -0,0 +1,382 @@
+/*
+ * snapshot.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "snapshot.h"
+#include "widget_values.h"
+#include "profiler.h"
+#include "series.h"
+#include <string.h>
+
+static uint16_t snapshot_length( const page_t *page, uint8_t layout, uint16_t *string_lengths );
+static void snapshot_fill( const page_t *page, char *data, const uint16_t *string_lengths );
+static void snapshot_fill_v2( const page_t *page, char *data, const uint16_t *string_lengths );
+
+
+snapshot_t *
+acquire_snapshot(
+		page_t *page,
+		uint8_t layout )
+{
+#ifdef DEBUG
+	assert( layout >= POLL_LAYOUT_V1 && layout <= POLL_LAYOUT_MAX );
+#endif
+
+	// values written by interrupt producer since last mainloop iteration invalidate cached snapshot
+	sync_producer( page, read_begin( page ) );
+	sync_series( page );
+
+	snapshot_t *snapshot = page->snapshot[ layout - 1 ];
+
+	if( snapshot && snapshot->generation == page->generation )
+	{
+		++snapshot->ref_count;
+		return snapshot;
+	}
+
+	// every string is scanned only once, lengths are reused when filling snapshot
+	uint16_t *string_lengths = (uint16_t *)mem_malloc( page->widget_count * sizeof( *string_lengths ) + 1 );
+	if( !string_lengths )
+		return NULL;
+
+	snapshot_t *new_snapshot;
+	PROFILE_BEGIN( serialize_start );
+
+	// snapshot is serialized again if producer wrote values meanwhile( varint lengths may differ too )
+	for( ;; )
+	{
+		uint32_t sequence = read_begin( page );
+
+		uint16_t len = snapshot_length( page, layout, string_lengths );
+
+		new_snapshot = (snapshot_t *)mem_malloc( sizeof( *new_snapshot ) + len );
+		if( !new_snapshot )
+		{
+			mem_free( string_lengths );
+			return NULL;
+		}
+
+		new_snapshot->len = len;
+		if( layout == POLL_LAYOUT_V2 )
+			snapshot_fill_v2( page, new_snapshot->data, string_lengths );
+		else
+			snapshot_fill( page, new_snapshot->data, string_lengths );
+
+		if( !read_retry( page, sequence ) )
+		{
+			sync_producer( page, sequence );
+			break;
+		}
+
+		mem_free( new_snapshot );
+	}
+
+	PROFILE_END( PROF_SERIALIZE, serialize_start );
+
+	new_snapshot->ref_count = 2; // page cache and caller
+	new_snapshot->generation = page->generation;
+
+	mem_free( string_lengths );
+
+	// cached snapshot could have been released when producer changed values
+	snapshot = page->snapshot[ layout - 1 ];
+	if( snapshot )
+		release_snapshot( snapshot );
+
+	page->snapshot[ layout - 1 ] = new_snapshot;
+
+	return new_snapshot;
+}
+
+void
+release_snapshot(
+		snapshot_t *snapshot )
+{
+#ifdef DEBUG
+	assert( snapshot->ref_count > 0 );
+#endif
+
+	if( !--snapshot->ref_count )
+		mem_free( snapshot );
+}
+
+void
+invalidate_snapshot(
+		page_t *page )
+{
+	++page->generation;
+
+	// nobody is sending cached snapshot, so memory can be freed right away
+	for( uint8_t idx = 0; idx < POLL_LAYOUT_MAX; ++idx )
+		if( page->snapshot[ idx ] && page->snapshot[ idx ]->ref_count == 1 )
+		{
+			release_snapshot( page->snapshot[ idx ] );
+			page->snapshot[ idx ] = NULL;
+		}
+}
+
+/**
+ * Zigzag encoding maps signed integers with small magnitude to small unsigned integers.
+ */
+static inline uint32_t
+zigzag(
+		int32_t value )
+{
+	return ( (uint32_t)value << 1 ) ^ (uint32_t)( value >> 31 );
+}
+
+static inline uint16_t
+varint_length(
+		uint32_t value )
+{
+	uint16_t len = 1;
+	while( value >= 0x80 )
+	{
+		value >>= 7;
+		++len;
+	}
+	return len;
+}
+
+static inline uint16_t
+write_varint(
+		char *data,
+		uint32_t value )
+{
+	uint16_t len = 0;
+	while( value >= 0x80 )
+	{
+		data[ len++ ] = (char)( ( value & 0x7F ) | 0x80 );
+		value >>= 7;
+	}
+	data[ len++ ] = (char)value;
+	return len;
+}
+
+/**
+ * Maps numeric value to unsigned integer stored as varint in layout 2.
+ * @return 1 if value is stored as varint, 0 if it is stored raw.
+ */
+static inline uint8_t
+varint_value(
+		enum value_type val_type,
+		const void *value,
+		uint32_t *encoded )
+{
+	switch( val_type )
+	{
+	case _int:
+	case _fixed:
+	{
+		int32_t number;
+		memcpy( &number, value, sizeof( number ) );
+		*encoded = zigzag( number );
+		return 1;
+	}
+	case _i16:
+	{
+		int16_t number;
+		memcpy( &number, value, sizeof( number ) );
+		*encoded = zigzag( number );
+		return 1;
+	}
+	case _u32:
+		memcpy( encoded, value, sizeof( *encoded ) );
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static uint16_t
+numeric_length_v2(
+		enum value_type val_type,
+		const void *value )
+{
+	uint32_t encoded;
+	if( varint_value( val_type, value, &encoded ) )
+		return varint_length( encoded );
+
+	return value_size( val_type );
+}
+
+static uint16_t
+write_numeric_v2(
+		char *data,
+		enum value_type val_type,
+		const void *value )
+{
+	uint32_t encoded;
+	if( varint_value( val_type, value, &encoded ) )
+		return write_varint( data, encoded );
+
+	memcpy( data, value, value_size( val_type ) );
+	return value_size( val_type );
+}
+
+/**
+ * Computes length of serialized values and stores length of each string into string_lengths.
+ */
+static uint16_t
+snapshot_length(
+		const page_t *page,
+		uint8_t layout,
+		uint16_t *string_lengths )
+{
+	uint16_t widget_count = page->widget_count;
+	const w_val_t *values = page->page_content;
+	uint16_t bin_length = 0;
+
+	if( layout == POLL_LAYOUT_V2 )
+	{
+		// enable bitmap followed by values
+		bin_length = ( widget_count + 7 ) / 8;
+
+		for( uint16_t idx = 0; idx < widget_count; ++idx )
+		{
+			switch( values[ idx ].val_type )
+			{
+			case _series:
+				bin_length += varint_length( values[ idx ].value.series_val->seq );
+				break;
+			case _string:
+				string_lengths[ idx ] = values[ idx ].value.string_val ? strlen( values[ idx ].value.string_val ) : 0;
+				bin_length += varint_length( string_lengths[ idx ] ) + string_lengths[ idx ];
+				break;
+			case _array:
+			{
+				// element count followed by elements encoded same as standalone values
+				const array_t *array = values[ idx ].value.array_val;
+				uint8_t size = value_size( array->element_type );
+				bin_length += varint_length( array->length );
+				for( uint16_t element = 0; element < array->length; ++element )
+					bin_length += numeric_length_v2( array->element_type, (const char *)array->data + element * size );
+				break;
+			}
+			default:
+				bin_length += numeric_length_v2( values[ idx ].val_type, &values[ idx ].value );
+			}
+		}
+
+		return bin_length;
+	}
+
+	for( uint16_t idx = 0; idx < widget_count; ++idx )
+	{
+		switch( values[ idx ].val_type )
+		{
+		case _series:
+			bin_length += sizeof( uint32_t ) + 1; // sequence number of next sample
+			break;
+		case _string:
+			string_lengths[ idx ] = values[ idx ].value.string_val ? strlen( values[ idx ].value.string_val ) : 0;
+			bin_length += string_lengths[ idx ] + 2; // trailing '\0' and enable
+			break;
+		case _array:
+			// element count, elements and enable
+			bin_length += sizeof( uint16_t ) + values[ idx ].value.array_val->length
+					* value_size( values[ idx ].value.array_val->element_type ) + 1;
+			break;
+		default:
+			bin_length += value_size( values[ idx ].val_type ) + 1;
+		}
+	}
+
+	return bin_length;
+}
+
+static void
+snapshot_fill(
+		const page_t *page,
+		char *data,
+		const uint16_t *string_lengths )
+{
+	uint16_t widget_count = page->widget_count;
+	const w_val_t *values = page->page_content;
+	uint16_t offset = 0;
+
+	for( uint16_t idx = 0; idx < widget_count; ++idx )
+	{
+		switch( values[ idx ].val_type )
+		{
+		case _series:
+			memcpy( data + offset, &values[ idx ].value.series_val->seq, sizeof( uint32_t ) );
+			offset += sizeof( uint32_t );
+			break;
+		case _string:
+			if( string_lengths[ idx ] )
+				memcpy( data + offset, values[ idx ].value.string_val, string_lengths[ idx ] );
+			offset += string_lengths[ idx ];
+			data[ offset++ ] = '\0';
+			break;
+		case _array:
+		{
+			const array_t *array = values[ idx ].value.array_val;
+			uint16_t array_len = array->length * value_size( array->element_type );
+			memcpy( data + offset, &array->length, sizeof( uint16_t ) );
+			offset += sizeof( uint16_t );
+			memcpy( data + offset, array->data, array_len );
+			offset += array_len;
+			break;
+		}
+		default:
+			// numeric values are stored in native little endian format of their size
+			memcpy( data + offset, &values[ idx ].value, value_size( values[ idx ].val_type ) );
+			offset += value_size( values[ idx ].val_type );
+		}
+		memcpy( data + offset, &values[ idx ].enabled, 1 );
+		offset += 1;
+	}
+}
+
+/**
+ * Fills values in layout 2: enable bitmap( bit per widget, LSB first ) followed by
+ * zigzag varint signed integers( int, i16, fixed ), varint u32 and sequence numbers,
+ * raw float, double, bool and u8, varint length prefixed strings
+ * and arrays as varint element count followed by elements.
+ */
+static void
+snapshot_fill_v2(
+		const page_t *page,
+		char *data,
+		const uint16_t *string_lengths )
+{
+	uint16_t widget_count = page->widget_count;
+	const w_val_t *values = page->page_content;
+	uint16_t offset = ( widget_count + 7 ) / 8;
+
+	memset( data, 0, offset );
+
+	for( uint16_t idx = 0; idx < widget_count; ++idx )
+	{
+		if( values[ idx ].enabled )
+			data[ idx / 8 ] |= 1 << ( idx % 8 );
+
+		switch( values[ idx ].val_type )
+		{
+		case _series:
+			offset += write_varint( data + offset, values[ idx ].value.series_val->seq );
+			break;
+		case _string:
+			offset += write_varint( data + offset, string_lengths[ idx ] );
+			if( string_lengths[ idx ] )
+				memcpy( data + offset, values[ idx ].value.string_val, string_lengths[ idx ] );
+			offset += string_lengths[ idx ];
+			break;
+		case _array:
+		{
+			const array_t *array = values[ idx ].value.array_val;
+			uint8_t size = value_size( array->element_type );
+			offset += write_varint( data + offset, array->length );
+			for( uint16_t element = 0; element < array->length; ++element )
+				offset += write_numeric_v2( data + offset, array->element_type, (const char *)array->data + element * size );
+			break;
+		}
+		default:
+			offset += write_numeric_v2( data + offset, values[ idx ].val_type, &values[ idx ].value );
+		}
+	}
+}
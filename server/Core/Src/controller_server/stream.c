@@ -0,0 +1,114 @@
+/*
+ * stream.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "stream.h"
+#include "snapshot.h"
+#include "lwip/udp.h"
+#include "lwip/sys.h"
+#include <string.h>
+
+extern struct ctrl_server server;
+
+/**
+ * Datagram header: sequence number( uint32 ) and page id( uint16 ), followed by values as in POLL response.
+ */
+#define STREAM_HEADER_LEN ( sizeof( uint32_t ) + sizeof( uint16_t ) )
+
+static struct udp_pcb *stream_pcb = NULL;
+
+static void stream_send( connection_t *conn );
+
+
+err_t stream_init( void )
+{
+	stream_pcb = udp_new();
+	if( !stream_pcb )
+		return ERR_MEM;
+
+	return ERR_OK;
+}
+
+void
+stream_start(
+		connection_t *conn,
+		uint16_t port,
+		uint16_t rate )
+{
+	if( rate > CTRL_MAX_STREAM_RATE )
+		rate = CTRL_MAX_STREAM_RATE;
+
+	conn->stream_port = rate ? port : 0;
+	conn->stream_period = rate ? 1000 / rate : 0;
+	conn->stream_last = sys_now();
+	conn->stream_seq = 0;
+
+	// first datagram is sent right away
+	conn->stream_page_id = ERR_PAGE_ID;
+}
+
+void stream_process( void )
+{
+	if( !stream_pcb )
+		return;
+
+	uint32_t now = sys_now();
+
+	for( connection_t *conn = server.connections; conn; conn = conn->next )
+	{
+		if( !conn->stream_port || ( conn->flags & C_CLOSING ) )
+			continue;
+
+		if( now - conn->stream_last < conn->stream_period )
+			continue;
+
+		page_t *page = server.pages[ conn->current_page_id ];
+
+		// unchanged values are repeated only as keep-alive
+		if( conn->stream_page_id == conn->current_page_id &&
+			conn->stream_generation == page->generation &&
+			now - conn->stream_last < CTRL_STREAM_KEEPALIVE )
+			continue;
+
+		conn->stream_last = now;
+		stream_send( conn );
+	}
+}
+
+/**
+ * Sends current values of connection page in single datagram.
+ * Datagram is dropped on memory shortage, next one is sent after stream period.
+ */
+static void
+stream_send(
+		connection_t *conn )
+{
+	page_t *page = server.pages[ conn->current_page_id ];
+
+	snapshot_t *snapshot = acquire_snapshot( page, conn->layout );
+	if( !snapshot )
+		return;
+
+	struct pbuf *p = pbuf_alloc( PBUF_TRANSPORT, STREAM_HEADER_LEN + snapshot->len, PBUF_RAM );
+	if( p )
+	{
+		char *data = (char *)p->payload;
+		memcpy( data, &conn->stream_seq, sizeof( conn->stream_seq ) );
+		memcpy( data + 4, &conn->current_page_id, sizeof( conn->current_page_id ) );
+		memcpy( data + STREAM_HEADER_LEN, snapshot->data, snapshot->len );
+
+		if( udp_sendto( stream_pcb, p, &conn->pcb->remote_ip, conn->stream_port ) == ERR_OK )
+		{
+			++conn->stream_seq;
+			conn->stream_page_id = conn->current_page_id;
+			conn->stream_generation = snapshot->generation;
+		}
+
+		pbuf_free( p );
+	}
+
+	release_snapshot( snapshot );
+}
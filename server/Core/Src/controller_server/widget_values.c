@@ -0,0 +1,474 @@
+/*
+ * widget_values.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "widget_values.h"
+#include "snapshot.h"
+#include "filter.h"
+#include "profiler.h"
+#include "series.h"
+#include <string.h>
+
+extern struct ctrl_server server;
+
+w_val_t *
+find_value(
+		uint16_t page_id,
+		uint16_t widget_id,
+		enum value_type val_type )
+{
+	if( page_id >= server.page_count )
+		return NULL;
+
+	page_t *page = server.pages[ page_id ];
+
+	if( widget_id >= page->widget_count )
+		return NULL;
+
+	w_val_t *value = page->page_content + widget_id;
+
+	if( value->val_type != val_type )
+		return NULL;
+
+	return value;
+}
+
+void
+mark_widget_dirty(
+		page_t *page,
+		uint16_t widget_id )
+{
+	page->dirty[ widget_id / 8 ] |= 1 << ( widget_id % 8 );
+#if CTRL_MQTT_BRIDGE
+	page->mqtt_dirty[ widget_id / 8 ] |= 1 << ( widget_id % 8 );
+#endif
+	filter_published( page, widget_id );
+	invalidate_snapshot( page );
+}
+
+void
+notify_widget_change(
+		page_t *page,
+		uint16_t widget_id )
+{
+	server.changed_page_id = page->page_id;
+	if( page->update_callback )
+	{
+		PROFILE_BEGIN( callback_start );
+		page->update_callback( widget_id, &server.old_value );
+		PROFILE_END( PROF_CALLBACK, callback_start );
+	}
+
+	// preallocated strings pass old value in scratch buffer
+	if( server.old_value.val_type == _string && !server.old_value.capacity )
+		mem_free( server.old_value.value.string_val );
+
+	// callback may also write values of page directly
+	mark_widget_dirty( page, widget_id );
+}
+
+const uint32_t powers_of_ten[ FIXED_MAX_SCALE + 1 ] =
+{
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+uint8_t
+value_size(
+		enum value_type val_type )
+{
+	switch( val_type )
+	{
+	case _bool:
+	case _u8:
+		return 1;
+	case _i16:
+		return 2;
+#if CTRL_DOUBLE_VALUES
+	case _double:
+		return 8;
+#endif
+	default:
+		return 4;
+	}
+}
+
+float
+numeric_value(
+		const w_val_t *value )
+{
+	switch( value->val_type )
+	{
+	case _int:
+		return value->value.int_val;
+	case _float:
+		return value->value.float_val;
+	case _bool:
+		return value->value.bool_val;
+	case _u8:
+		return value->value.u8_val;
+	case _i16:
+		return value->value.i16_val;
+	case _u32:
+		return value->value.u32_val;
+	case _fixed:
+		return value->value.fixed_val / ( float )powers_of_ten[ value->scale ];
+#if CTRL_DOUBLE_VALUES
+	case _double:
+		return value->value.double_val;
+#endif
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Stores numeric value passed in value union of new_value, applies filters and marks widget dirty.
+ */
+static err_t
+set_number(
+		uint16_t page_id,
+		uint16_t widget_id,
+		enum value_type val_type,
+		const w_val_t *new_value )
+{
+	w_val_t *current = find_value( page_id, widget_id, val_type );
+	if( !current )
+		return ERR_ARG;
+
+	page_t *page = server.pages[ page_id ];
+
+	// value returned to published one, so held change is obsolete
+	if( !memcmp( &current->value, &new_value->value, value_size( val_type ) ) )
+	{
+		filter_release( page, widget_id );
+		return ERR_OK;
+	}
+
+	// scale of fixed point value is property of widget
+	w_val_t updated = *current;
+	updated.value = new_value->value;
+
+	enum filter_result result = filter_value( page, widget_id, numeric_value( current ), numeric_value( &updated ) );
+	if( result == FILTER_DROP )
+		return ERR_OK;
+
+	// held value would change cached snapshot without new generation
+	if( result == FILTER_HOLD )
+	{
+		filter_hold( page, widget_id, &updated );
+		return ERR_OK;
+	}
+
+	current->value = new_value->value;
+	mark_widget_dirty( page, widget_id );
+	return ERR_OK;
+}
+
+err_t
+set_int(
+		uint16_t page_id,
+		uint16_t widget_id,
+		int32_t value )
+{
+	w_val_t new_value = { .value.int_val = value };
+	return set_number( page_id, widget_id, _int, &new_value );
+}
+
+err_t
+set_float(
+		uint16_t page_id,
+		uint16_t widget_id,
+		float value )
+{
+	w_val_t new_value = { .value.float_val = value };
+	return set_number( page_id, widget_id, _float, &new_value );
+}
+
+err_t
+set_bool(
+		uint16_t page_id,
+		uint16_t widget_id,
+		uint8_t value )
+{
+	w_val_t new_value = { .value.bool_val = !!value };
+	return set_number( page_id, widget_id, _bool, &new_value );
+}
+
+err_t
+set_u8(
+		uint16_t page_id,
+		uint16_t widget_id,
+		uint8_t value )
+{
+	w_val_t new_value = { .value.u8_val = value };
+	return set_number( page_id, widget_id, _u8, &new_value );
+}
+
+err_t
+set_i16(
+		uint16_t page_id,
+		uint16_t widget_id,
+		int16_t value )
+{
+	w_val_t new_value = { .value.i16_val = value };
+	return set_number( page_id, widget_id, _i16, &new_value );
+}
+
+err_t
+set_u32(
+		uint16_t page_id,
+		uint16_t widget_id,
+		uint32_t value )
+{
+	w_val_t new_value = { .value.u32_val = value };
+	return set_number( page_id, widget_id, _u32, &new_value );
+}
+
+err_t
+set_fixed(
+		uint16_t page_id,
+		uint16_t widget_id,
+		int32_t value )
+{
+	w_val_t new_value = { .value.fixed_val = value };
+	return set_number( page_id, widget_id, _fixed, &new_value );
+}
+
+#if CTRL_DOUBLE_VALUES
+err_t
+set_double(
+		uint16_t page_id,
+		uint16_t widget_id,
+		double value )
+{
+	w_val_t new_value = { .value.double_val = value };
+	return set_number( page_id, widget_id, _double, &new_value );
+}
+#endif
+
+void
+read_array_element(
+		const w_val_t *array_value,
+		uint16_t index,
+		w_val_t *element )
+{
+	const array_t *array = array_value->value.array_val;
+	uint8_t size = value_size( array->element_type );
+
+	memset( element, 0, sizeof( *element ) );
+	element->val_type = array->element_type;
+	element->enabled = array_value->enabled;
+	element->scale = array_value->scale;
+	memcpy( &element->value, (const char *)array->data + index * size, size );
+}
+
+void
+write_array_element(
+		w_val_t *array_value,
+		uint16_t index,
+		const w_val_t *element )
+{
+	array_t *array = array_value->value.array_val;
+	uint8_t size = value_size( array->element_type );
+
+	memcpy( (char *)array->data + index * size, &element->value, size );
+}
+
+err_t
+set_array(
+		uint16_t page_id,
+		uint16_t widget_id,
+		uint16_t first,
+		uint16_t count,
+		const void *values )
+{
+	w_val_t *current = find_value( page_id, widget_id, _array );
+	if( !current )
+		return ERR_ARG;
+
+	array_t *array = current->value.array_val;
+	if( (uint32_t)first + count > array->length )
+		return ERR_ARG;
+
+	uint8_t size = value_size( array->element_type );
+	char *target = (char *)array->data + first * size;
+	if( !memcmp( target, values, count * size ) )
+		return ERR_OK;
+
+	memcpy( target, values, count * size );
+	mark_widget_dirty( server.pages[ page_id ], widget_id );
+	return ERR_OK;
+}
+
+err_t
+set_string(
+		uint16_t page_id,
+		uint16_t widget_id,
+		char *value )
+{
+	w_val_t *current = find_value( page_id, widget_id, _string );
+	if( !current )
+		return ERR_ARG;
+
+	if( current->capacity )
+	{
+		if( !value )
+			value = "";
+
+		size_t len = strlen( value );
+		if( len > current->capacity )
+		{
+#if CTRL_STRING_TRUNCATE
+			len = current->capacity;
+#else
+			return ERR_VAL;
+#endif
+		}
+
+		if( !strncmp( current->value.string_val, value, len ) && current->value.string_val[ len ] == '\0' )
+			return ERR_OK;
+
+		memcpy( current->value.string_val, value, len );
+		current->value.string_val[ len ] = '\0';
+		mark_widget_dirty( server.pages[ page_id ], widget_id );
+		return ERR_OK;
+	}
+
+	char *old = current->value.string_val;
+	current->value.string_val = value;
+
+	// pointer is always replaced, but same content does not generate traffic
+	if( old == value || ( old && value && !strcmp( old, value ) ) )
+		return ERR_OK;
+
+	mark_widget_dirty( server.pages[ page_id ], widget_id );
+	return ERR_OK;
+}
+
+err_t
+set_enabled(
+		uint16_t page_id,
+		uint16_t widget_id,
+		uint8_t enabled )
+{
+	if( page_id >= server.page_count || widget_id >= server.pages[ page_id ]->widget_count )
+		return ERR_ARG;
+
+	page_t *page = server.pages[ page_id ];
+	w_val_t *current = page->page_content + widget_id;
+
+	enabled = !!enabled;
+	if( current->enabled == enabled )
+		return ERR_OK;
+
+	current->enabled = enabled;
+	mark_widget_dirty( page, widget_id );
+	return ERR_OK;
+}
+
+void
+mark_dirty(
+		uint16_t page_id,
+		uint16_t widget_id )
+{
+#ifdef DEBUG
+	assert( page_id < server.page_count );
+	assert( widget_id < server.pages[ page_id ]->widget_count );
+#endif
+
+	mark_widget_dirty( server.pages[ page_id ], widget_id );
+}
+
+uint8_t
+is_dirty(
+		uint16_t page_id,
+		uint16_t widget_id )
+{
+#ifdef DEBUG
+	assert( page_id < server.page_count );
+	assert( widget_id < server.pages[ page_id ]->widget_count );
+#endif
+
+	page_t *page = server.pages[ page_id ];
+	return ( page->dirty[ widget_id / 8 ] >> ( widget_id % 8 ) ) & 1;
+}
+
+void
+clear_dirty(
+		uint16_t page_id )
+{
+#ifdef DEBUG
+	assert( page_id < server.page_count );
+#endif
+
+	page_t *page = server.pages[ page_id ];
+	memset( page->dirty, 0, ( page->widget_count + 7 ) / 8 );
+}
+
+uint32_t
+page_generation(
+		uint16_t page_id )
+{
+#ifdef DEBUG
+	assert( page_id < server.page_count );
+#endif
+
+	return server.pages[ page_id ]->generation;
+}
+
+void
+page_write_begin(
+		uint16_t page_id )
+{
+#ifdef DEBUG
+	assert( page_id < server.page_count );
+#endif
+
+	page_t *page = server.pages[ page_id ];
+	page->sequence = page->sequence + 1;
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+}
+
+void
+page_write_end(
+		uint16_t page_id )
+{
+#ifdef DEBUG
+	assert( page_id < server.page_count );
+#endif
+
+	page_t *page = server.pages[ page_id ];
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+	page->sequence = page->sequence + 1;
+}
+
+void
+sync_producer(
+		page_t *page,
+		uint32_t sequence )
+{
+	if( sequence == page->seen_sequence || ( sequence & 1 ) )
+		return;
+
+	// producer does not tell which widgets it wrote
+	uint16_t dirty_len = ( page->widget_count + 7 ) / 8;
+	memset( page->dirty, 0xFF, dirty_len );
+#if CTRL_MQTT_BRIDGE
+	memset( page->mqtt_dirty, 0xFF, dirty_len );
+#endif
+	page->seen_sequence = sequence;
+	invalidate_snapshot( page );
+}
+
+void sync_producers( void )
+{
+	for( uint16_t page_id = 0; page_id < server.page_count; ++page_id )
+	{
+		page_t *page = server.pages[ page_id ];
+		sync_producer( page, read_begin( page ) );
+		sync_series( page );
+	}
+}
@@ -0,0 +1,117 @@
+/*
+ * work_queue.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: stefan
+ */
+
+#include "work_queue.h"
+
+#if CTRL_DEFERRED_CALLBACKS
+
+#include "input_parser.h"
+#include "widget_values.h"
+#include <string.h>
+
+extern struct ctrl_server server;
+
+static struct
+{
+	work_item_t items[ CTRL_WORK_QUEUE_LENGTH ];
+	uint8_t head;
+	uint8_t count;
+} queue;
+
+
+uint8_t work_full( void )
+{
+	return queue.count == CTRL_WORK_QUEUE_LENGTH;
+}
+
+void
+work_push(
+		connection_t *conn,
+		uint16_t page_id,
+		uint8_t batch )
+{
+#ifdef DEBUG
+	assert( !work_full() );
+#endif
+
+	work_item_t *item = queue.items + ( queue.head + queue.count ) % CTRL_WORK_QUEUE_LENGTH;
+	++queue.count;
+
+	item->conn = conn;
+	item->page_id = page_id;
+	item->done = 0;
+
+	if( batch )
+	{
+		// batch is owned by item until callbacks ran
+		item->batch = server.batch;
+		item->batch_len = server.batch_len;
+		server.batch = NULL;
+		server.batch_len = 0;
+		return;
+	}
+
+	item->batch = NULL;
+	item->batch_len = 0;
+	item->widget_id = server.widget_id;
+	item->array_index = server.array_index;
+	memcpy( &item->old_value, &server.old_value, sizeof( item->old_value ) );
+
+	// scratch buffer is reused by next SET
+	if( item->old_value.val_type == _string && item->old_value.capacity )
+	{
+		strcpy( item->old_string, server.old_string );
+		item->old_value.value.string_val = item->old_string;
+	}
+}
+
+work_item_t *work_peek( void )
+{
+	return queue.count ? queue.items + queue.head : NULL;
+}
+
+void
+work_run(
+		work_item_t *item )
+{
+	page_t *page = server.pages[ item->page_id ];
+
+	if( item->batch )
+	{
+		notify_set_batch( page, item->batch, item->batch_len );
+		free_batch( item->batch, item->batch_len );
+		item->batch = NULL;
+	}
+	else
+	{
+		memcpy( &server.old_value, &item->old_value, sizeof( server.old_value ) );
+		server.array_index = item->array_index;
+		notify_widget_change( page, item->widget_id );
+	}
+
+	item->done = 1;
+}
+
+void work_pop( void )
+{
+	queue.head = ( queue.head + 1 ) % CTRL_WORK_QUEUE_LENGTH;
+	--queue.count;
+}
+
+void
+work_detach(
+		connection_t *conn )
+{
+	for( uint8_t idx = 0; idx < queue.count; ++idx )
+	{
+		work_item_t *item = queue.items + ( queue.head + idx ) % CTRL_WORK_QUEUE_LENGTH;
+		if( item->conn == conn )
+			item->conn = NULL;
+	}
+}
+
+#endif
@@ -25,6 +25,7 @@
 /* USER CODE BEGIN Includes */
 
 #include "controller_server.h"
+#include "mqtt_bridge.h"
 #include <assert.h>
 #include <string.h>
 #include "pages/page0.h"
@@ -70,21 +71,34 @@ static void MX_ADC2_Init(void);
 
 void update_values( void )
 {
-	values3[ 1 ].value.int_val = HAL_GPIO_ReadPin( user_button_GPIO_Port, user_button_Pin );
+	static uint32_t last_sample = 0;
+
+	set_bool( 3, 1, HAL_GPIO_ReadPin( user_button_GPIO_Port, user_button_Pin ) );
 
 	uint32_t value;
+	float adc1, adc2;
 
 	HAL_ADC_Start( &hadc1 );
 	HAL_ADC_PollForConversion( &hadc1, 10 );
 	value = HAL_ADC_GetValue( &hadc1 );
 	HAL_ADC_Stop( &hadc1 );
-	values3[ 2 ].value.float_val = (float)value / (float)( 1 << 12 ) * 3.3f;
+	adc1 = (float)value / (float)( 1 << 12 ) * 3.3f;
+	set_float( 3, 2, adc1 );
 
 	HAL_ADC_Start( &hadc2 );
 	HAL_ADC_PollForConversion( &hadc2, 10 );
 	value = HAL_ADC_GetValue( &hadc2 );
 	HAL_ADC_Stop( &hadc2 );
-	values3[ 3 ].value.float_val = (float)value / (float)( 1 << 12 ) * 3.3f;
+	adc2 = (float)value / (float)( 1 << 12 ) * 3.3f;
+	set_float( 3, 3, adc2 );
+
+	// charts are sampled at 1 kHz
+	if( sys_now() != last_sample )
+	{
+		last_sample = sys_now();
+		series_push( 3, 4, adc1 );
+		series_push( 3, 5, adc2 );
+	}
 }
 
 /* USER CODE END 0 */
@@ -135,7 +149,14 @@ int main(void)
   add_page( page0, values0, 4, page0_callback );
   add_page( page1, values1, 4, page1_callback );
   add_page( page2, values2, 4, page2_callback );
-  add_page( page3, values3, 4, page3_callback );
+  add_page( page3, values3, 6, page3_callback );
+  set_page_filters( 3, filters3 );
+
+#if CTRL_MQTT_BRIDGE
+  ip_addr_t broker;
+  IP_ADDR4( &broker, 192, 168, 1, 1 );
+  mqtt_bridge_start( &broker, 1883, "nucleo" );
+#endif
 
   mainloop();
 
@@ -36,7 +36,7 @@ void page0_callback( uint16_t widget_id, w_val_t *_ )
 
 	if( widget_id == 0 && values0[ 0 ].value.int_val == 1 )
 	{
-		values0[ 0 ].value.int_val = 0;
+		set_int( 0, 0, 0 );
 		HAL_GPIO_WritePin( GPIOB, led_green_Pin, GPIO_PIN_RESET );
 		HAL_GPIO_WritePin( GPIOB, led_blue_Pin, GPIO_PIN_RESET );
 		HAL_GPIO_WritePin( GPIOB, led_red_Pin, GPIO_PIN_RESET );
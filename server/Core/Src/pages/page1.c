@@ -37,21 +37,21 @@ void page1_callback( uint16_t widget_id, w_val_t *_ )
 
 	if( widget_id == 0 && values1[ 0 ].value.int_val == 1 )
 	{
-		values1[ 0 ].value.int_val = 0;
-		values1[ 2 ].value.int_val = 0;
-		values1[ 3 ].value.int_val = 0;
+		set_int( 1, 0, 0 );
+		set_int( 1, 2, 0 );
+		set_int( 1, 3, 0 );
 		change_page( 0 );
 	}
 
 	if( widget_id == 1 && values1[ 1 ].value.int_val == 1 )
 	{
-		values1[ 1 ].value.int_val = 0;
+		set_int( 1, 1, 0 );
 		change_page( 2 );
 	}
 
 	if( widget_id == 2 )
 	{
-		values1[ 3 ].value.int_val = values1[ 2 ].value.int_val;
+		set_int( 1, 3, values1[ 2 ].value.int_val );
 	}
 
 	HAL_GPIO_WritePin( GPIOB, led_green_Pin, GPIO_PIN_RESET );
@@ -19,18 +19,23 @@ const char *page2 = "{\"size\":[3,3],\"widgets\":["
 					"]}";
 
 
+static char login[ 16 ];
+static char password[ 16 ];
+
 w_val_t values2[] = { { .value.int_val = 0,
 						.val_type = _int,
 						.enabled = 1 },
 					  { .value.int_val = 0,
 						.val_type = _int,
 						.enabled = 0 },
-					  { .value.string_val = NULL,
+					  { .value.string_val = login,
 						.val_type = _string,
-						.enabled = 1 },
-					  { .value.string_val = NULL,
+						.enabled = 1,
+						.capacity = sizeof( login ) - 1 },
+					  { .value.string_val = password,
 						.val_type = _string,
-						.enabled = 1 } };
+						.enabled = 1,
+						.capacity = sizeof( password ) - 1 } };
 
 
 void page2_callback( uint16_t widget_id, w_val_t *_ )
@@ -40,7 +45,7 @@ void page2_callback( uint16_t widget_id, w_val_t *_ )
 
 	if( widget_id == 0 && values2[ 0 ].value.int_val == 1 )
 	{
-		values2[ 0 ].value.int_val = 0;
+		set_int( 2, 0, 0 );
 		change_page( 1 );
 	}
 
@@ -48,14 +53,11 @@ void page2_callback( uint16_t widget_id, w_val_t *_ )
 	if( widget_id == 3 )
 	{
 		// check if login and password is correct
-		if( values2[ 2 ].value.string_val && !strcmp( values2[ 2 ].value.string_val, "admin")
-		 && values2[ 3 ].value.string_val && !strcmp( values2[ 3 ].value.string_val, "admin") )
+		if( !strcmp( login, "admin") && !strcmp( password, "admin") )
 			change_page( 3 );
 
 		// delete login and password
-		mem_free( values2[ 2 ].value.string_val );
-		mem_free( values2[ 3 ].value.string_val );
-		values2[ 2 ].value.string_val = NULL;
-		values2[ 3 ].value.string_val = NULL;
+		set_string( 2, 2, "" );
+		set_string( 2, 3, "" );
 	}
 }
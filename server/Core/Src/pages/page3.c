@@ -7,36 +7,59 @@
 
 #include "page3.h"
 
-const char *page3 = "{\"size\":[2,3],\"widgets\":["
+const char *page3 = "{\"size\":[3,3],\"widgets\":["
 					"{\"type\":\"button\", \"text\":\"previous page\"},"
 					"{\"type\":\"label\", \"text\":\"Page 3\"},"
-					"{\"type\":\"value\", \"value_type\": \"int32\", \"text\":\"Button\", \"special\": {\"off\": 0, \"on\": 1}, \"position\":[1, 0]},"
+					"{\"type\":\"value\", \"value_type\": \"bool\", \"text\":\"Button\", \"special\": {\"off\": 0, \"on\": 1}, \"position\":[1, 0]},"
 					"{\"type\":\"value\", \"value_type\": \"float\", \"text\":\"ADC1:\", \"unit\": \"V\"},"
-					"{\"type\":\"value\", \"value_type\": \"float\", \"text\":\"ADC2:\", \"unit\": \"V\"}"
+					"{\"type\":\"value\", \"value_type\": \"float\", \"text\":\"ADC2:\", \"unit\": \"V\"},"
+					"{\"type\":\"chart\", \"text\":\"ADC1\", \"unit\": \"V\", \"range\": [0, 3.3], \"samples\": 2000, \"position\":[2, 0]},"
+					"{\"type\":\"chart\", \"text\":\"ADC2\", \"unit\": \"V\", \"range\": [0, 3.3], \"samples\": 2000}"
 					"]}";
 
+static series_sample_t adc1_samples[ 512 ];
+static series_sample_t adc2_samples[ 512 ];
+
+static series_t adc1_series = { .samples = adc1_samples, .capacity = 512 };
+static series_t adc2_series = { .samples = adc2_samples, .capacity = 512 };
+
 
 w_val_t values3[] = { { .value.int_val = 0,
 						.val_type = _int,
 						.enabled = 1 },
-					  { .value.int_val = 0,
-						.val_type = _int,
+					  { .value.bool_val = 0,
+						.val_type = _bool,
 						.enabled = 1 },
 					  { .value.int_val = 0,
 						.val_type = _float,
 						.enabled = 1 },
 					  { .value.int_val = 0,
 						.val_type = _float,
+						.enabled = 1 },
+					  { .value.series_val = &adc1_series,
+						.val_type = _series,
+						.enabled = 1 },
+					  { .value.series_val = &adc2_series,
+						.val_type = _series,
 						.enabled = 1 } };
 
 
+// ADC readings are noisy, only changes over 10 mV are published and at most 10 times per second
+const widget_filter_t filters3[] = { { .deadband = 0 },
+									 { .deadband = 0 },
+									 { .deadband = 0.01f, .min_interval = 100 },
+									 { .deadband = 0.01f, .min_interval = 100 },
+									 { .deadband = 0 },
+									 { .deadband = 0 } };
+
+
 void page3_callback( uint16_t widget_id, w_val_t *_ )
 {
 	assert( widget_id == 0 );
 
 	if( widget_id == 0 && values3[ 0 ].value.int_val == 1 )
 	{
-		values3[ 0 ].value.int_val = 0;
+		set_int( 3, 0, 0 );
 		change_page( 2 );
 	}
 }
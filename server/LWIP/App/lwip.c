@@ -28,7 +28,7 @@
 #include "ethernetif.h"
 
 /* USER CODE BEGIN 0 */
-
+#include "profiler.h"
 /* USER CODE END 0 */
 /* Private function prototypes -----------------------------------------------*/
 static void ethernet_link_status_updated(struct netif *netif);
@@ -152,10 +152,12 @@ static void Ethernet_Link_Periodic_Handle(struct netif *netif)
 void MX_LWIP_Process(void)
 {
 /* USER CODE BEGIN 4_1 */
+  PROFILE_BEGIN( input_start );
 /* USER CODE END 4_1 */
   ethernetif_input(&gnetif);
 
 /* USER CODE BEGIN 4_2 */
+  PROFILE_END( PROF_ETHERNET_INPUT, input_start );
 /* USER CODE END 4_2 */
   /* Handle timeouts */
   sys_check_timeouts();
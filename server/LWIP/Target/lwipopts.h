@@ -102,6 +102,90 @@
 /*-----------------------------------------------------------------------------*/
 /* USER CODE BEGIN 1 */
 
+/*
+ * MQTT bridge of controller server( see server/README.md ).
+ * Bridge uses one TCP PCB and cyclic timer of lwIP MQTT client.
+ */
+#ifndef CTRL_MQTT_BRIDGE
+#define CTRL_MQTT_BRIDGE 0
+#endif
+
+#if CTRL_MQTT_BRIDGE
+#define MEMP_NUM_SYS_TIMEOUT ( LWIP_NUM_SYS_TIMEOUT_INTERNAL + 1 )
+#define MQTT_OUTPUT_RINGBUF_SIZE 1024
+#endif
+
+/*
+ * Configuration profiles of controller server.
+ * Profile is selected by defining LWIP_PROFILE as one of LWIP_PROFILE_* values
+ * (in USER CODE 0 section or as compiler symbol).
+ * Without profile values generated by CubeMX above are used.
+ * Memory budget and connection limits of each profile are documented in server/README.md.
+ */
+#define LWIP_PROFILE_LOW_MEMORY 1
+#define LWIP_PROFILE_MANY_CLIENTS 2
+#define LWIP_PROFILE_HIGH_THROUGHPUT 3
+
+#if defined( LWIP_PROFILE )
+
+#undef MEM_SIZE
+#undef TCP_SND_QUEUELEN
+#undef TCP_SNDLOWAT
+#undef TCP_SNDQUEUELOWAT
+#undef TCP_WND_UPDATE_THRESHOLD
+
+#if LWIP_PROFILE == LWIP_PROFILE_LOW_MEMORY
+/*----- Two clients, small pages -----*/
+#define MEM_SIZE 6144
+#define PBUF_POOL_SIZE 4
+#define TCP_MSS 536
+#define TCP_WND ( 2 * TCP_MSS )
+#define TCP_SND_BUF ( 2 * TCP_MSS )
+#define TCP_SND_QUEUELEN 4
+#define TCP_SNDQUEUELOWAT 2
+#define MEMP_NUM_TCP_SEG 8
+#define MEMP_NUM_TCP_PCB 3
+#define CTRL_MAX_CONNECTIONS ( 2 - CTRL_MQTT_BRIDGE )
+#define MAX_TOKEN_COUNT 64
+
+#elif LWIP_PROFILE == LWIP_PROFILE_MANY_CLIENTS
+/*----- Up to ten clients, small windows per connection -----*/
+#define MEM_SIZE 16384
+#define PBUF_POOL_SIZE 8
+#define TCP_MSS 536
+#define TCP_WND ( 2 * TCP_MSS )
+#define TCP_SND_BUF ( 2 * TCP_MSS )
+#define TCP_SND_QUEUELEN 4
+#define TCP_SNDQUEUELOWAT 2
+#define MEMP_NUM_TCP_SEG 32
+#define MEMP_NUM_TCP_PCB 12
+#define CTRL_MAX_CONNECTIONS ( 10 - CTRL_MQTT_BRIDGE )
+#define MAX_TOKEN_COUNT 128
+
+#elif LWIP_PROFILE == LWIP_PROFILE_HIGH_THROUGHPUT
+/*----- Few clients, full size segments and large pages -----*/
+#define MEM_SIZE 32768
+#define PBUF_POOL_SIZE 12
+#define TCP_MSS 1460
+#define TCP_WND ( 4 * TCP_MSS )
+#define TCP_SND_BUF ( 4 * TCP_MSS )
+#define TCP_SND_QUEUELEN 16
+#define TCP_SNDQUEUELOWAT 8
+#define MEMP_NUM_TCP_SEG 32
+#define MEMP_NUM_TCP_PCB 5
+#define CTRL_MAX_CONNECTIONS ( 4 - CTRL_MQTT_BRIDGE )
+#define MAX_TOKEN_COUNT 256
+
+#else
+#error "Unknown LWIP_PROFILE"
+#endif
+
+/*----- Same formulas as defaults in opt.h -----*/
+#define TCP_SNDLOWAT LWIP_MIN( LWIP_MAX( ( ( TCP_SND_BUF ) / 2 ), ( 2 * TCP_MSS ) + 1 ), ( TCP_SND_BUF ) - 1 )
+#define TCP_WND_UPDATE_THRESHOLD LWIP_MIN( ( TCP_WND / 4 ), ( TCP_MSS * 4 ) )
+
+#endif /* LWIP_PROFILE */
+
 /* USER CODE END 1 */
 
 #ifdef __cplusplus
@@ -0,0 +1,176 @@
+/*
+ * seqlock_test.c
+ *
+ * Host stress test of interrupt producer seqlock( page_write_begin/page_write_end ).
+ * Writer thread stands in for interrupt and rewrites whole array page in loop,
+ * main thread serializes snapshots of the page and checks that no snapshot holds torn array.
+ */
+
+#include "snapshot.h"
+#include "widget_values.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ELEMENT_COUNT 64
+#define ROUNDS 200000
+
+struct ctrl_server server;
+
+static page_t page;
+static page_t *pages[ 1 ] = { &page };
+static int32_t elements[ ELEMENT_COUNT ];
+static array_t array = { .data = elements, .length = ELEMENT_COUNT, .element_type = _int };
+static volatile int stop;
+
+void *
+mem_malloc(
+		mem_size_t size )
+{
+	return malloc( size );
+}
+
+void
+mem_free(
+		void *mem )
+{
+	free( mem );
+}
+
+uint32_t
+sys_now(
+		void )
+{
+	return 0;
+}
+
+/**
+ * Writes same value into every element, values alternate sign and magnitude,
+ * so varint lengths of layout 2 change between writes too.
+ */
+static void *
+writer(
+		void *arg )
+{
+	volatile int32_t *data = elements;
+
+	for( int32_t n = 1; !stop; n = n % 100000 + 1 )
+	{
+		page_write_begin( 0 );
+		for( uint16_t idx = 0; idx < ELEMENT_COUNT; ++idx )
+			data[ idx ] = ( n & 1 ) ? n * 1000 : -n;
+		page_write_end( 0 );
+	}
+
+	return NULL;
+}
+
+/**
+ * Layout 1: element count followed by raw elements and enable.
+ * @return 1 if all elements are equal.
+ */
+static int
+check_v1(
+		const snapshot_t *snapshot )
+{
+	uint16_t count;
+	memcpy( &count, snapshot->data, sizeof( count ) );
+	if( count != ELEMENT_COUNT || snapshot->len != 2 + 4 * ELEMENT_COUNT + 1 )
+		return 0;
+
+	int32_t first;
+	memcpy( &first, snapshot->data + 2, sizeof( first ) );
+
+	for( uint16_t idx = 1; idx < ELEMENT_COUNT; ++idx )
+	{
+		int32_t value;
+		memcpy( &value, snapshot->data + 2 + 4 * idx, sizeof( value ) );
+		if( value != first )
+			return 0;
+	}
+
+	return 1;
+}
+
+static uint32_t
+read_varint(
+		const snapshot_t *snapshot,
+		uint16_t *offset )
+{
+	uint32_t value = 0;
+	for( uint8_t shift = 0; *offset < snapshot->len; shift += 7 )
+	{
+		uint8_t byte = (uint8_t)snapshot->data[ ( *offset )++ ];
+		value |= (uint32_t)( byte & 0x7F ) << shift;
+		if( !( byte & 0x80 ) )
+			break;
+	}
+	return value;
+}
+
+/**
+ * Layout 2: enable bitmap, element count and zigzag varint elements.
+ * @return 1 if all elements are equal and they fill snapshot exactly.
+ */
+static int
+check_v2(
+		const snapshot_t *snapshot )
+{
+	uint16_t offset = 1;
+	if( read_varint( snapshot, &offset ) != ELEMENT_COUNT )
+		return 0;
+
+	uint32_t first = read_varint( snapshot, &offset );
+	for( uint16_t idx = 1; idx < ELEMENT_COUNT; ++idx )
+		if( read_varint( snapshot, &offset ) != first )
+			return 0;
+
+	return offset == snapshot->len;
+}
+
+int
+main(
+		void )
+{
+	static uint8_t dirty[ 1 ];
+	static w_val_t values[] = { { .value.array_val = &array, .val_type = _array, .enabled = 1 } };
+
+	page.page_content = values;
+	page.widget_count = 1;
+	page.dirty = dirty;
+	server.pages = pages;
+	server.page_count = 1;
+
+	pthread_t thread;
+	if( pthread_create( &thread, NULL, writer, NULL ) )
+	{
+		perror( "pthread_create" );
+		return 2;
+	}
+
+	long torn = 0;
+	for( long round = 0; round < ROUNDS; ++round )
+	{
+		for( uint8_t layout = POLL_LAYOUT_V1; layout <= POLL_LAYOUT_MAX; ++layout )
+		{
+			snapshot_t *snapshot = acquire_snapshot( &page, layout );
+			if( !snapshot )
+			{
+				fprintf( stderr, "snapshot allocation failed\n" );
+				return 2;
+			}
+
+			if( !( layout == POLL_LAYOUT_V2 ? check_v2( snapshot ) : check_v1( snapshot ) ) )
+				++torn;
+
+			release_snapshot( snapshot );
+		}
+	}
+
+	stop = 1;
+	pthread_join( thread, NULL );
+
+	printf( "seqlock: %d snapshots, %ld torn\n", ROUNDS * POLL_LAYOUT_MAX, torn );
+	return torn != 0;
+}